@@ -0,0 +1,177 @@
+/*
+ * aggregate.c
+ * Per-folder file counts and byte totals, gathered during a search walk
+ * instead of a second "du"-style pass over the same tree.
+ * search.c creates one node per folder it queues and reports each
+ * folder's own files once it has listed them; the totals are added to
+ * the folder and every folder above it, so each node ends up holding its
+ * whole subtree. Adds are interlocked, so walks on several threads may
+ * feed the same tree.
+ */
+
+#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define AGG_BLOCK_NODES 1024
+
+struct agg_node {
+    struct agg_node   *parent;
+    char              *path;
+    volatile LONGLONG  files;
+    volatile LONGLONG  bytes;
+};
+
+/* Nodes are handed out from fixed blocks so their addresses never move */
+struct agg_block {
+    struct agg_block *next;
+    size_t            used;
+    struct agg_node   nodes[AGG_BLOCK_NODES];
+};
+
+struct agg_tree {
+    SRWLOCK           lock;
+    struct agg_block *blocks;
+    size_t            count;
+};
+
+/* -------------------------------------------------------------------------
+ * Internal helpers (static)
+ * ---------------------------------------------------------------------- */
+
+static int by_bytes_desc(const void *a, const void *b)
+{
+    const struct agg_node *x = *(const struct agg_node *const *)a;
+    const struct agg_node *y = *(const struct agg_node *const *)b;
+    if (x->bytes != y->bytes) {
+        return (x->bytes < y->bytes) ? 1 : -1;
+    }
+    if (x->files != y->files) {
+        return (x->files < y->files) ? 1 : -1;
+    }
+    return strcmp(x->path, y->path);
+}
+
+/* -------------------------------------------------------------------------
+ * Public functions
+ * ---------------------------------------------------------------------- */
+
+void *agg_create(void)
+{
+    struct agg_tree *tree = (struct agg_tree *)calloc(1, sizeof(*tree));
+    if (tree != NULL) {
+        InitializeSRWLock(&tree->lock);
+    }
+    return tree;
+}
+
+void agg_free(void *tree_ptr)
+{
+    struct agg_tree *tree = (struct agg_tree *)tree_ptr;
+    if (tree == NULL) {
+        return;
+    }
+    struct agg_block *block = tree->blocks;
+    while (block != NULL) {
+        struct agg_block *next = block->next;
+        size_t i;
+        for (i = 0; i < block->used; ++i) {
+            free(block->nodes[i].path);
+        }
+        free(block);
+        block = next;
+    }
+    free(tree);
+}
+
+/* Adds a folder below parent (NULL for the walk's root). Returns NULL if
+ * out of memory; search.c then charges that folder to its parent. */
+void *agg_add_dir(void *tree_ptr, void *parent, const char *path)
+{
+    struct agg_tree *tree = (struct agg_tree *)tree_ptr;
+    size_t len = strlen(path) + 1;
+    char  *copy = (char *)malloc(len);
+    struct agg_node *node = NULL;
+
+    if (copy == NULL) {
+        return NULL;
+    }
+    memcpy(copy, path, len);
+
+    AcquireSRWLockExclusive(&tree->lock);
+    if (tree->blocks == NULL || tree->blocks->used == AGG_BLOCK_NODES) {
+        struct agg_block *block = (struct agg_block *)malloc(sizeof(*block));
+        if (block != NULL) {
+            block->next  = tree->blocks;
+            block->used  = 0;
+            tree->blocks = block;
+        }
+    }
+    if (tree->blocks != NULL && tree->blocks->used < AGG_BLOCK_NODES) {
+        node = &tree->blocks->nodes[tree->blocks->used++];
+        node->parent = (struct agg_node *)parent;
+        node->path   = copy;
+        node->files  = 0;
+        node->bytes  = 0;
+        tree->count += 1;
+    }
+    ReleaseSRWLockExclusive(&tree->lock);
+
+    if (node == NULL) {
+        free(copy);
+    }
+    return node;
+}
+
+/* Adds one folder's own files to it and to every folder above it */
+void agg_add_files(void *node_ptr, unsigned long long files,
+                   unsigned long long bytes)
+{
+    struct agg_node *node = (struct agg_node *)node_ptr;
+    if (files == 0) {
+        return;
+    }
+    while (node != NULL) {
+        InterlockedExchangeAdd64(&node->files, (LONGLONG)files);
+        InterlockedExchangeAdd64(&node->bytes, (LONGLONG)bytes);
+        node = node->parent;
+    }
+}
+
+/* Calls emit for the top_n largest folders by bytes, largest first.
+ * Call once the walk is over. Returns how many folders were reported. */
+size_t agg_report(void *tree_ptr, size_t top_n,
+                  void (*emit)(const char *path, unsigned long long files,
+                               unsigned long long bytes, void *ctx),
+                  void *ctx)
+{
+    struct agg_tree *tree = (struct agg_tree *)tree_ptr;
+    struct agg_node **order;
+    struct agg_block *block;
+    size_t n = 0;
+    size_t i;
+
+    if (tree == NULL || tree->count == 0) {
+        return 0;
+    }
+    order = (struct agg_node **)malloc(tree->count * sizeof(*order));
+    if (order == NULL) {
+        return 0;
+    }
+    for (block = tree->blocks; block != NULL; block = block->next) {
+        for (i = 0; i < block->used; ++i) {
+            order[n++] = &block->nodes[i];
+        }
+    }
+    qsort(order, n, sizeof(*order), by_bytes_desc);
+
+    if (top_n > n) {
+        top_n = n;
+    }
+    for (i = 0; i < top_n; ++i) {
+        emit(order[i]->path, (unsigned long long)order[i]->files,
+             (unsigned long long)order[i]->bytes, ctx);
+    }
+    free(order);
+    return top_n;
+}
@@ -0,0 +1,193 @@
+/*
+ * first_match_bench.c
+ * Console benchmark for the best-first walk in search.c.
+ * - Times how long the walk takes to find its first match, and the whole
+ *   walk, once in plain level order and then best-first over several
+ *   searches, so the effect of the hit history shows up run by run.
+ * - Can build a synthetic tree where the only matches sit deep in one of
+ *   many folders, so the numbers can be reproduced anywhere.
+ *
+ * Build (from the "version 2" folder):
+ *     gcc bench/first_match_bench.c search.c utils.c throttle.c aggregate.c -o first_match_bench.exe
+ * Run:
+ *     first_match_bench /make <folder>        create the synthetic tree
+ *     first_match_bench <root> <prefix> [runs] time searches, default 5 runs
+ */
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_DEFAULT_RUNS  5
+#define BENCH_TOP_DIRS      200
+#define BENCH_SUB_DIRS      10
+#define BENCH_FILES         5
+#define BENCH_PATH_CAP      1024
+
+/* Function from search.c */
+extern void search_directory_each(const char *root_dir, const char *term,
+                                  const char *hint,
+                                  void (*on_match)(const char *full_path,
+                                                   const char *name, void *ctx),
+                                  void *ctx);
+
+/* search.c's window searches hand their matches to results.c, which this
+ * program does not link; they are never called here. */
+void result_add(const char *full_path)
+{
+    (void)full_path;
+}
+
+struct run_stats {
+    double start;
+    double first;     /* ms to the first match, -1 if none */
+    size_t matches;
+};
+
+/* -------------------------------------------------------------------------
+ * Timing
+ * ---------------------------------------------------------------------- */
+
+static double now_ms(void)
+{
+    static LONGLONG freq = 0;
+    LARGE_INTEGER t;
+    if (freq == 0) {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        freq = f.QuadPart;
+    }
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart * 1000.0 / (double)freq;
+}
+
+static void on_match(const char *full_path, const char *name, void *ctx)
+{
+    struct run_stats *stats = (struct run_stats *)ctx;
+    (void)full_path;
+    (void)name;
+    if (stats->matches++ == 0) {
+        stats->first = now_ms() - stats->start;
+    }
+}
+
+/* One walk. A NULL hint lists folders in plain level order. */
+static void run_once(const char *label, int run, const char *root,
+                     const char *prefix, const char *hint)
+{
+    struct run_stats stats;
+    stats.first   = -1.0;
+    stats.matches = 0;
+    stats.start   = now_ms();
+    search_directory_each(root, prefix, hint, on_match, &stats);
+    double total = now_ms() - stats.start;
+
+    printf("%-11s run %d  first match %9.3f ms  whole walk %9.1f ms  %lu matches\n",
+           label, run, stats.first, total, (unsigned long)stats.matches);
+}
+
+/* -------------------------------------------------------------------------
+ * Synthetic tree
+ * ---------------------------------------------------------------------- */
+
+static int make_dir(const char *path)
+{
+    return CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+static int make_file(const char *path)
+{
+    HANDLE h = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                           FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+    CloseHandle(h);
+    return 1;
+}
+
+/* BENCH_TOP_DIRS folders of BENCH_SUB_DIRS folders of BENCH_FILES files,
+ * plus the only "report" files, four levels down in one of them. */
+static int make_tree(const char *root)
+{
+    char path[BENCH_PATH_CAP];
+    int d, s, f;
+
+    if (!make_dir(root)) {
+        return 0;
+    }
+    for (d = 0; d < BENCH_TOP_DIRS; ++d) {
+        snprintf(path, sizeof(path), "%s\\d%03d", root, d);
+        if (!make_dir(path)) {
+            return 0;
+        }
+        for (s = 0; s < BENCH_SUB_DIRS; ++s) {
+            snprintf(path, sizeof(path), "%s\\d%03d\\s%02d", root, d, s);
+            if (!make_dir(path)) {
+                return 0;
+            }
+            for (f = 0; f < BENCH_FILES; ++f) {
+                snprintf(path, sizeof(path), "%s\\d%03d\\s%02d\\f%02d.dat",
+                         root, d, s, f);
+                if (!make_file(path)) {
+                    return 0;
+                }
+            }
+        }
+    }
+    static const char *const deep[] = { "archive", "2024", "reports" };
+    size_t len = (size_t)snprintf(path, sizeof(path), "%s\\d%03d",
+                                  root, BENCH_TOP_DIRS * 3 / 4);
+    for (d = 0; d < 3; ++d) {
+        len += (size_t)snprintf(path + len, sizeof(path) - len, "\\%s", deep[d]);
+        if (!make_dir(path)) {
+            return 0;
+        }
+    }
+    for (f = 0; f < 3; ++f) {
+        snprintf(path + len, sizeof(path) - len, "\\report_%d.txt", f);
+        if (!make_file(path)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    int runs = BENCH_DEFAULT_RUNS;
+    int i;
+
+    if (argc == 3 && strcmp(argv[1], "/make") == 0) {
+        if (!make_tree(argv[2])) {
+            printf("could not create the tree under %s\n", argv[2]);
+            return 1;
+        }
+        printf("tree created; try: first_match_bench %s report\n", argv[2]);
+        return 0;
+    }
+    if (argc < 3) {
+        printf("usage: first_match_bench /make <folder>\n"
+               "       first_match_bench <root> <prefix> [runs]\n");
+        return 1;
+    }
+    if (argc > 3) {
+        runs = atoi(argv[3]);
+    }
+    if (runs < 1) {
+        runs = 1;
+    }
+
+    /* One untimed walk so every run reads from the same warm cache */
+    run_once("warm-up", 0, argv[1], argv[2], NULL);
+    for (i = 1; i <= runs; ++i) {
+        run_once("level order", i, argv[1], argv[2], NULL);
+    }
+    /* Run 1 only has the folder names to go on; later runs also have
+     * the hit history of the runs before them */
+    for (i = 1; i <= runs; ++i) {
+        run_once("best-first", i, argv[1], argv[2], argv[2]);
+    }
+    return 0;
+}
@@ -0,0 +1,204 @@
+/*
+ * pipe_bench.c
+ * Console load benchmark for the /serve pipe server in server.c.
+ * - Connects to \\.\pipe\file_search like any script would, warms one root
+ *   with a single FIND, then sends FIND, COUNT and EXISTS in turn against
+ *   that root and times every round trip.
+ * - Reports the average, median and 99th percentile per request kind, so
+ *   the cost of the cached path (cache lookup, binary search, reply) can be
+ *   seen apart from the cold walk.
+ *
+ * Build (from the "version 2" folder):
+ *     gcc bench/pipe_bench.c -o pipe_bench.exe
+ * Run (with "file_search /serve" already running):
+ *     pipe_bench <root> <prefix> [rounds]    default 1000 rounds
+ */
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_PIPE_NAME      "\\\\.\\pipe\\file_search"
+#define BENCH_DEFAULT_ROUNDS 1000
+#define BENCH_KINDS          3
+#define BENCH_LINE_CAP       4096
+
+static const char *const g_kinds[BENCH_KINDS] = { "FIND", "COUNT", "EXISTS" };
+
+/* Reads the reply byte stream a line at a time */
+struct reply_reader {
+    HANDLE pipe;
+    char   buf[BENCH_LINE_CAP];
+    DWORD  len;
+    DWORD  pos;
+};
+
+/* -------------------------------------------------------------------------
+ * Timing
+ * ---------------------------------------------------------------------- */
+
+static double now_us(void)
+{
+    static LONGLONG freq = 0;
+    LARGE_INTEGER t;
+    if (freq == 0) {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        freq = f.QuadPart;
+    }
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart * 1000000.0 / (double)freq;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* -------------------------------------------------------------------------
+ * Pipe client
+ * ---------------------------------------------------------------------- */
+
+static int send_all(HANDLE pipe, const char *text, size_t len)
+{
+    while (len > 0) {
+        DWORD put = 0;
+        if (!WriteFile(pipe, text, (DWORD)len, &put, NULL) || put == 0) {
+            return 0;
+        }
+        text += put;
+        len  -= put;
+    }
+    return 1;
+}
+
+/* Copies the next reply line into line, without its newline.
+ * Returns 0 if the server closed the pipe. */
+static int read_line(struct reply_reader *r, char *line, size_t cap)
+{
+    size_t n = 0;
+    for (;;) {
+        if (r->pos == r->len) {
+            if (!ReadFile(r->pipe, r->buf, sizeof(r->buf), &r->len, NULL) ||
+                r->len == 0) {
+                return 0;
+            }
+            r->pos = 0;
+        }
+        char c = r->buf[r->pos++];
+        if (c == '\n') {
+            line[n] = '\0';
+            return 1;
+        }
+        if (c != '\r' && n + 1 < cap) {
+            line[n++] = c;
+        }
+    }
+}
+
+/* Sends one request and reads up to its closing "OK" or "ERR" line.
+ * Path lines never start with either: they begin with the root.
+ * Returns 1 for an OK reply, 0 for ERR or a broken pipe. */
+static int round_trip(struct reply_reader *r, const char *request,
+                      char *last, size_t cap)
+{
+    last[0] = '\0';
+    if (!send_all(r->pipe, request, strlen(request))) {
+        return 0;
+    }
+    for (;;) {
+        if (!read_line(r, last, cap)) {
+            return 0;
+        }
+        if (strncmp(last, "OK ", 3) == 0) {
+            return 1;
+        }
+        if (strncmp(last, "ERR", 3) == 0) {
+            return 0;
+        }
+    }
+}
+
+static void print_stats(const char *kind, double *samples, int n)
+{
+    double sum = 0.0;
+    int i;
+    for (i = 0; i < n; ++i) {
+        sum += samples[i];
+    }
+    qsort(samples, (size_t)n, sizeof(double), compare_double);
+    printf("%-7s %6d requests  avg %9.1f us  median %9.1f us  p99 %9.1f us\n",
+           kind, n, sum / n, samples[n / 2], samples[(n * 99) / 100]);
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = BENCH_DEFAULT_ROUNDS;
+    char request[BENCH_KINDS][BENCH_LINE_CAP];
+    char last[BENCH_LINE_CAP];
+    double *samples[BENCH_KINDS];
+    struct reply_reader r;
+    int i, k;
+
+    if (argc < 3) {
+        printf("usage: pipe_bench <root> <prefix> [rounds]\n");
+        return 1;
+    }
+    if (argc > 3) {
+        rounds = atoi(argv[3]);
+    }
+    if (rounds < 1) {
+        rounds = 1;
+    }
+
+    r.pipe = CreateFileA(BENCH_PIPE_NAME, GENERIC_READ | GENERIC_WRITE, 0,
+                         NULL, OPEN_EXISTING, 0, NULL);
+    if (r.pipe == INVALID_HANDLE_VALUE) {
+        printf("could not connect to %s; start \"file_search /serve\" first\n",
+               BENCH_PIPE_NAME);
+        return 1;
+    }
+    r.len = 0;
+    r.pos = 0;
+
+    for (k = 0; k < BENCH_KINDS; ++k) {
+        snprintf(request[k], sizeof(request[k]), "%s\t%s\t%s\n",
+                 g_kinds[k], argv[1], argv[2]);
+        samples[k] = (double *)malloc((size_t)rounds * sizeof(double));
+        if (samples[k] == NULL) {
+            printf("out of memory\n");
+            return 1;
+        }
+    }
+
+    /* The sorted FIND waits for the whole walk, so the root is cached
+     * before the first timed request */
+    double start = now_us();
+    if (!round_trip(&r, request[0], last, sizeof(last))) {
+        printf("warm-up FIND failed: %s\n", last);
+        return 1;
+    }
+    printf("warm-up FIND %.1f ms  (%s)\n", (now_us() - start) / 1000.0, last);
+
+    for (i = 0; i < rounds; ++i) {
+        for (k = 0; k < BENCH_KINDS; ++k) {
+            start = now_us();
+            if (!round_trip(&r, request[k], last, sizeof(last))) {
+                printf("%s failed after %d rounds: %s\n", g_kinds[k], i, last);
+                return 1;
+            }
+            samples[k][i] = now_us() - start;
+        }
+    }
+
+    printf("last reply: %s\n", last);
+    for (k = 0; k < BENCH_KINDS; ++k) {
+        print_stats(g_kinds[k], samples[k], rounds);
+        free(samples[k]);
+    }
+    CloseHandle(r.pipe);
+    return 0;
+}
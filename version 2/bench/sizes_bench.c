@@ -0,0 +1,174 @@
+/*
+ * sizes_bench.c
+ * Console benchmark for the folder-size walk in search.c.
+ * - Times search_directory_all against search_directory_sizes on the same
+ *   tree and prefix, so the cost of adding up sizes during the search (the
+ *   folder tree, the per-entry sums, sizing hidden entries) can be read off
+ *   directly.
+ * - Sizes are run both for all files and for matching files only, and the
+ *   totals of the root folder are printed so the two can be checked.
+ *
+ * Build (from the "version 2" folder):
+ *     gcc bench/sizes_bench.c search.c utils.c throttle.c aggregate.c -o sizes_bench.exe
+ * Run:
+ *     sizes_bench <root> <prefix> [runs]    default 5 runs per mode
+ */
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_DEFAULT_RUNS 5
+#define BENCH_MODES        3
+
+/* Functions from search.c */
+extern void search_directory_all  (const char *root_dir, const char *term, int *found);
+extern void search_directory_sizes(const char *root_dir, const char *term, int *found,
+                                   int matches_only, void *tree);
+
+/* Functions from aggregate.c */
+extern void  *agg_create(void);
+extern void   agg_free  (void *tree);
+extern size_t agg_report(void *tree, size_t top_n,
+                         void (*emit)(const char *path, unsigned long long files,
+                                      unsigned long long bytes, void *ctx),
+                         void *ctx);
+
+static const char *const g_modes[BENCH_MODES] = {
+    "plain search", "sizes, all files", "sizes, matches"
+};
+
+/* search.c hands window-search matches to results.c, which this program
+ * does not link; count them here instead. */
+static size_t g_matches = 0;
+
+void result_add(const char *full_path)
+{
+    (void)full_path;
+    ++g_matches;
+}
+
+struct root_total {
+    unsigned long long files;
+    unsigned long long bytes;
+};
+
+/* -------------------------------------------------------------------------
+ * Timing
+ * ---------------------------------------------------------------------- */
+
+static double now_ms(void)
+{
+    static LONGLONG freq = 0;
+    LARGE_INTEGER t;
+    if (freq == 0) {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        freq = f.QuadPart;
+    }
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart * 1000.0 / (double)freq;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* The largest folder is the root itself, which holds everything counted */
+static void keep_root(const char *path, unsigned long long files,
+                      unsigned long long bytes, void *ctx)
+{
+    struct root_total *total = (struct root_total *)ctx;
+    (void)path;
+    total->files = files;
+    total->bytes = bytes;
+}
+
+/* One walk in the given mode. Returns its time in ms. */
+static double run_once(int mode, const char *root, const char *prefix,
+                       struct root_total *total)
+{
+    int found = 0;
+    void *tree = NULL;
+
+    total->files = 0;
+    total->bytes = 0;
+    g_matches    = 0;
+    if (mode > 0) {
+        tree = agg_create();
+        if (tree == NULL) {
+            return -1.0;
+        }
+    }
+
+    double start = now_ms();
+    if (mode == 0) {
+        search_directory_all(root, prefix, &found);
+    } else {
+        search_directory_sizes(root, prefix, &found, mode == 2, tree);
+    }
+    double elapsed = now_ms() - start;
+
+    if (tree != NULL) {
+        agg_report(tree, 1, keep_root, total);
+        agg_free(tree);
+    }
+    return elapsed;
+}
+
+int main(int argc, char **argv)
+{
+    int runs = BENCH_DEFAULT_RUNS;
+    struct root_total total;
+    double *times;
+    int mode, i;
+
+    if (argc < 3) {
+        printf("usage: sizes_bench <root> <prefix> [runs]\n");
+        return 1;
+    }
+    if (argc > 3) {
+        runs = atoi(argv[3]);
+    }
+    if (runs < 1) {
+        runs = 1;
+    }
+    times = (double *)malloc((size_t)runs * sizeof(double));
+    if (times == NULL) {
+        printf("out of memory\n");
+        return 1;
+    }
+
+    /* One untimed walk so every mode reads from the same warm cache */
+    run_once(0, argv[1], argv[2], &total);
+
+    double plain = 0.0;
+    for (mode = 0; mode < BENCH_MODES; ++mode) {
+        for (i = 0; i < runs; ++i) {
+            times[i] = run_once(mode, argv[1], argv[2], &total);
+            if (times[i] < 0.0) {
+                printf("out of memory\n");
+                free(times);
+                return 1;
+            }
+        }
+        qsort(times, (size_t)runs, sizeof(double), compare_double);
+        double median = times[runs / 2];
+        if (mode == 0) {
+            plain = median;
+        }
+        printf("%-17s median %9.1f ms  min %9.1f ms  %+6.1f%%  %lu matches",
+               g_modes[mode], median, times[0],
+               (plain > 0.0) ? (median - plain) * 100.0 / plain : 0.0,
+               (unsigned long)g_matches);
+        if (mode > 0) {
+            printf("  root %llu files %llu bytes", total.files, total.bytes);
+        }
+        printf("\n");
+    }
+    free(times);
+    return 0;
+}
@@ -0,0 +1,266 @@
+/*
+ * sort_bench.c
+ * Console benchmark for sort.c.
+ * - Builds synthetic path lists shaped like real search results: long
+ *   shared prefixes, many files per folder, some paths repeated with
+ *   different case.
+ * - Times paths_sort_unique against qsort followed by a de-duplication
+ *   pass, for every order the server offers.
+ * - Checks that both produce the same list, so it doubles as a test.
+ *
+ * Build (from the "version 2" folder):
+ *     gcc bench/sort_bench.c sort.c -o sort_bench.exe
+ * Run:
+ *     sort_bench [count]       default count is 1000000
+ * Returns 0 if every result matched, 1 otherwise.
+ */
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define BENCH_DEFAULT_COUNT  1000000
+#define BENCH_DUPLICATE_RATE 10        /* one path in this many repeats */
+#define BENCH_PATH_CAP       300
+#define SORT_FAILED          ((size_t)-1)  /* paths_sort_unique ran out of memory */
+
+/* Function from sort.c */
+extern size_t paths_sort_unique(const char **paths, size_t count,
+                                int by_name, int fold_case);
+
+/* Order used by the qsort comparator. qsort takes no context pointer,
+ * so it is set before each run. */
+static int g_by_name   = 0;
+static int g_fold_case = 0;
+
+/* -------------------------------------------------------------------------
+ * Reference sort
+ * ---------------------------------------------------------------------- */
+
+static double now_ms(void)
+{
+    static LONGLONG freq = 0;
+    LARGE_INTEGER t;
+    if (freq == 0) {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        freq = f.QuadPart;
+    }
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart * 1000.0 / (double)freq;
+}
+
+static const char *file_name_of(const char *path)
+{
+    const char *name = path;
+    const char *p;
+    for (p = path; *p; ++p) {
+        if (*p == '\\' || *p == '/') {
+            name = p + 1;
+        }
+    }
+    return name;
+}
+
+/* Byte order, or tolower byte order when folding - the same order
+ * sort.c uses */
+static int compare_text(const char *a, const char *b)
+{
+    for (;; ++a, ++b) {
+        int x = (unsigned char)*a;
+        int y = (unsigned char)*b;
+        if (g_fold_case) {
+            x = tolower(x);
+            y = tolower(y);
+        }
+        if (x != y || x == 0) {
+            return x - y;
+        }
+    }
+}
+
+static int compare_paths(const void *pa, const void *pb)
+{
+    const char *a = *(const char *const *)pa;
+    const char *b = *(const char *const *)pb;
+    int r = 0;
+    if (g_by_name) {
+        r = compare_text(file_name_of(a), file_name_of(b));
+    }
+    if (r == 0) {
+        r = compare_text(a, b);
+    }
+    return r;
+}
+
+static size_t qsort_unique(const char **paths, size_t count)
+{
+    size_t kept = 0;
+    size_t i;
+
+    qsort(paths, count, sizeof(*paths), compare_paths);
+    for (i = 0; i < count; ++i) {
+        if (kept == 0 || compare_paths(&paths[i], &paths[kept - 1]) != 0) {
+            paths[kept++] = paths[i];
+        }
+    }
+    return kept;
+}
+
+/* -------------------------------------------------------------------------
+ * Test data
+ * ---------------------------------------------------------------------- */
+
+/* Small generator so every run and platform sees the same paths */
+static unsigned long g_seed = 7;
+
+static unsigned long next_random(void)
+{
+    g_seed = g_seed * 1103515245UL + 12345UL;
+    return (g_seed >> 16) & 0x7FFF;
+}
+
+/* Fills pool with count paths under the given roots. Returns 0 if out
+ * of memory. */
+static int make_paths(char **pool, size_t count,
+                      const char *const *roots, size_t root_count)
+{
+    size_t i;
+    for (i = 0; i < count; ++i) {
+        char path[BENCH_PATH_CAP];
+
+        if (i > 0 && next_random() % BENCH_DUPLICATE_RATE == 0) {
+            /* Same file again, sometimes spelled with different case */
+            strcpy(path, pool[next_random() % i]);
+            if (next_random() % 2) {
+                path[3] = (char)toupper((unsigned char)path[3]);
+            }
+        } else {
+            snprintf(path, sizeof(path), "%ssub%lu\\%s%lu_%c.txt",
+                     roots[next_random() % root_count], next_random() % 50,
+                     (next_random() % 2) ? "Report" : "report",
+                     next_random() * 8 + next_random() % 8,
+                     (char)('a' + next_random() % 26));
+        }
+        pool[i] = (char *)malloc(strlen(path) + 1);
+        if (pool[i] == NULL) {
+            return 0;
+        }
+        strcpy(pool[i], path);
+    }
+    return 1;
+}
+
+static void free_paths(char **pool, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; ++i) {
+        free(pool[i]);
+        pool[i] = NULL;
+    }
+}
+
+/* -------------------------------------------------------------------------
+ * Benchmark
+ * ---------------------------------------------------------------------- */
+
+/* Runs every order over one data set. Returns 0 if any result differs. */
+static int run_set(const char *label, char **pool, size_t count)
+{
+    const char **radix = (const char **)malloc(count * sizeof(*radix));
+    const char **ref   = (const char **)malloc(count * sizeof(*ref));
+    int ok = 1;
+
+    if (radix == NULL || ref == NULL) {
+        free(radix);
+        free(ref);
+        printf("%s: out of memory\n", label);
+        return 0;
+    }
+
+    for (g_by_name = 0; g_by_name < 2; ++g_by_name) {
+        for (g_fold_case = 0; g_fold_case < 2; ++g_fold_case) {
+            memcpy(radix, pool, count * sizeof(*radix));
+            memcpy(ref,   pool, count * sizeof(*ref));
+
+            double start      = now_ms();
+            size_t radix_kept = paths_sort_unique(radix, count, g_by_name, g_fold_case);
+            double radix_ms   = now_ms() - start;
+
+            start = now_ms();
+            size_t ref_kept = qsort_unique(ref, count);
+            double ref_ms   = now_ms() - start;
+
+            if (radix_kept == SORT_FAILED) {
+                printf("%s: out of memory\n", label);
+                ok = 0;
+                break;
+            }
+            int same = (radix_kept == ref_kept);
+            size_t i;
+            for (i = 0; same && i < radix_kept; ++i) {
+                same = (compare_paths(&radix[i], &ref[i]) == 0);
+            }
+            ok = ok && same;
+
+            printf("%-12s %-5s %-10s %8lu kept  radix %8.1f ms  qsort %8.1f ms  %s\n",
+                   label, g_by_name ? "name" : "path",
+                   g_fold_case ? "fold case" : "exact",
+                   (unsigned long)radix_kept, radix_ms, ref_ms,
+                   same ? "ok" : "MISMATCH");
+        }
+    }
+    free(radix);
+    free(ref);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    static const char *const one_root[] = {
+        "C:\\Users\\alice\\Documents\\Projects\\",
+        "C:\\Users\\alice\\Documents\\Projects\\build\\obj\\",
+    };
+    static const char *const mixed_roots[] = {
+        "C:\\Users\\alice\\Documents\\Projects\\",
+        "C:\\Users\\alice\\Documents\\Projects\\build\\obj\\",
+        "D:\\Share\\Finance\\2024\\Reports\\",
+        "C:\\Program Files\\Vendor\\App\\lib\\",
+    };
+    size_t count = BENCH_DEFAULT_COUNT;
+    char **pool;
+    int ok = 1;
+
+    if (argc > 1) {
+        count = (size_t)strtoul(argv[1], NULL, 10);
+    }
+    if (count == 0) {
+        printf("usage: sort_bench [count]\n");
+        return 1;
+    }
+    pool = (char **)calloc(count, sizeof(*pool));
+    if (pool == NULL) {
+        printf("out of memory\n");
+        return 1;
+    }
+
+    if (make_paths(pool, count, one_root, 2)) {
+        ok = run_set("one root", pool, count) && ok;
+    } else {
+        printf("out of memory\n");
+        ok = 0;
+    }
+    free_paths(pool, count);
+
+    if (make_paths(pool, count, mixed_roots, 4)) {
+        ok = run_set("mixed roots", pool, count) && ok;
+    } else {
+        printf("out of memory\n");
+        ok = 0;
+    }
+    free_paths(pool, count);
+    free(pool);
+    return ok ? 0 : 1;
+}
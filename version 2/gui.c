@@ -21,6 +21,9 @@
 #define ID_BTN_SEARCH    2004
 #define ID_LIST_RESULTS  2005
 
+/* How many folders the Alt+Search size report lists */
+#define SIZE_REPORT_TOP    20
+
 /* Window class and title */
 #define WINDOW_CLASS_NAME  "FileSearchWindow"
 #define WINDOW_TITLE       "File Search"
@@ -33,9 +36,29 @@ extern HWND g_hEditTerm;
 /* Functions from search.c */
 extern void search_directory_all    (const char *root_dir, const char *term, int *found);
 extern void search_directory_shallow(const char *root_dir, const char *term, int *found);
+extern size_t search_count_per_dir  (const char *root_dir, const char *term,
+                                     void (*on_dir)(const char *dir, size_t count,
+                                                    void *ctx),
+                                     void *ctx);
+extern void search_directory_sizes  (const char *root_dir, const char *term,
+                                     int *found, int matches_only, void *tree);
+
+/* Functions from aggregate.c */
+extern void  *agg_create(void);
+extern void   agg_free  (void *tree);
+extern size_t agg_report(void *tree, size_t top_n,
+                         void (*emit)(const char *path, unsigned long long files,
+                                      unsigned long long bytes, void *ctx),
+                         void *ctx);
 
 /* Functions from results.c */
 extern void results_clear          (void);
+extern void results_flush          (void);
+extern void result_add_dir_count   (const char *dir, size_t count);
+extern void results_show_count     (size_t count);
+extern void results_show_subtree   (size_t rank, const char *dir,
+                                    unsigned long long files,
+                                    unsigned long long bytes);
 extern void results_show_not_found (void);
 
 /* -------------------------------------------------------------------------
@@ -132,6 +155,21 @@ static void create_child_controls(HWND hwnd)
  * Button event handlers (static)
  * ---------------------------------------------------------------------- */
 
+/* Adapter for search_count_per_dir */
+static void add_dir_count(const char *dir, size_t count, void *ctx)
+{
+    (void)ctx;
+    result_add_dir_count(dir, count);
+}
+
+/* Adapter for agg_report; ctx points at the running rank */
+static void show_subtree(const char *path, unsigned long long files,
+                         unsigned long long bytes, void *ctx)
+{
+    size_t *rank = (size_t *)ctx;
+    results_show_subtree(++*rank, path, files, bytes);
+}
+
 static void handle_browse(HWND hwnd)
 {
     BROWSEINFOA bi;
@@ -169,16 +207,46 @@ static void handle_search(HWND hwnd)
 
     results_clear();
 
-    int found = 0;
+    int    found    = 0;
+    int    counting = 0;
+    size_t total    = 0;
+    void  *tree     = NULL;
     SHORT shift_state = GetKeyState(VK_SHIFT);
+    SHORT ctrl_state  = GetKeyState(VK_CONTROL);
+    SHORT alt_state   = GetKeyState(VK_MENU);
     if ((shift_state & 0x8000) != 0) {
         search_directory_shallow(root, term, &found);
+    } else if ((alt_state & 0x8000) != 0) {
+        /* Sizes of all files, or with Ctrl too, of the matching ones,
+         * gathered in the same walk */
+        tree = agg_create();
+        if (tree != NULL) {
+            search_directory_sizes(root, term, &found,
+                                   (ctrl_state & 0x8000) != 0, tree);
+        } else {
+            search_directory_all(root, term, &found);
+        }
+    } else if ((ctrl_state & 0x8000) != 0) {
+        /* Counts only: one line per directory, then the total */
+        total    = search_count_per_dir(root, term, add_dir_count, NULL);
+        found    = (total > 0);
+        counting = 1;
     } else {
         search_directory_all(root, term, &found);
     }
 
+    results_flush();
     if (!found) {
         results_show_not_found();
+    } else if (counting) {
+        results_show_count(total);
+    }
+
+    /* The largest folders go below the matches */
+    if (tree != NULL) {
+        size_t rank = 0;
+        agg_report(tree, SIZE_REPORT_TOP, show_subtree, &rank);
+        agg_free(tree);
     }
 }
 
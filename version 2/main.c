@@ -5,10 +5,13 @@
  * - Initialises COM (needed for the folder-picker in gui.c).
  * - Registers the window class and creates the main window via gui.c.
  * - Runs the Win32 message loop.
+ * - Or, when started with "/serve", runs the pipe server in server.c instead.
  */
 
 #include <windows.h>
 #include <objbase.h>
+#include <stdio.h>
+#include <string.h>
 
 #define PATH_CAP 32768
 
@@ -26,6 +29,70 @@ HWND g_hEditTerm            = NULL;
 extern int  gui_register_class    (HINSTANCE hInst);
 extern HWND gui_create_main_window(HINSTANCE hInst, int nShow);
 
+/* Function from server.c */
+extern int  server_run(void);
+
+/* Function from throttle.c */
+extern void throttle_configure(double dirs_per_sec, double entries_per_sec);
+
+/* Functions from utils.c */
+extern int  str_equals_icase     (const char *a, const char *b);
+extern int  str_starts_with_icase(const char *text, const char *prefix);
+
+/* -------------------------------------------------------------------------
+ * Command line
+ *     /serve                       run the pipe server at full speed
+ *     /serve /background           walk at background priority
+ *     /serve /background:D[,E]     also cap at D directories opened and E
+ *                                  entries listed per second (0 = no cap)
+ * Returns 1 if the server should run, 0 for the normal window and -1 if
+ * the /serve options could not be read.
+ * ---------------------------------------------------------------------- */
+
+static int parse_server_args(const char *cmd)
+{
+    char rest[64];
+    size_t len;
+
+    if (!str_starts_with_icase(cmd, "/serve")) {
+        return 0;
+    }
+    cmd += strlen("/serve");
+    while (*cmd == ' ') {
+        ++cmd;
+    }
+    len = strlen(cmd);
+    while (len > 0 && cmd[len - 1] == ' ') {
+        --len;
+    }
+    if (len >= sizeof(rest)) {
+        return -1;
+    }
+    memcpy(rest, cmd, len);
+    rest[len] = '\0';
+
+    if (rest[0] == '\0') {
+        return 1;
+    }
+    if (str_equals_icase(rest, "/background")) {
+        throttle_configure(0.0, 0.0);
+        return 1;
+    }
+    if (str_starts_with_icase(rest, "/background:")) {
+        const char *spec = rest + strlen("/background:");
+        double dirs    = 0.0;
+        double entries = 0.0;
+        int    used    = -1;
+        int    got     = sscanf(spec, "%lf%n,%lf%n", &dirs, &used, &entries, &used);
+        if (got >= 1 && used >= 0 && spec[used] == '\0' &&
+            dirs >= 0.0 && entries >= 0.0) {
+            throttle_configure(dirs, entries);
+            return 1;
+        }
+    }
+    return -1;
+}
+
 /* -------------------------------------------------------------------------
  * Entry point
  * ---------------------------------------------------------------------- */
@@ -34,7 +101,25 @@ int WINAPI WinMain(HINSTANCE hInst, HINSTANCE hPrev,
                    LPSTR lpCmd, int nShow)
 {
     (void)hPrev;
-    (void)lpCmd;
+
+    int serve = parse_server_args(lpCmd);
+    if (serve < 0) {
+        MessageBoxA(NULL, "Unknown /serve options.\n\n"
+                    "Use /serve, /serve /background or "
+                    "/serve /background:D[,E].",
+                    "Startup Error", MB_ICONERROR | MB_OK);
+        return 1;
+    }
+    if (serve) {
+        int rc = server_run();
+        if (rc == 2) {
+            MessageBoxA(NULL, "Could not create the pipe "
+                        "\\\\.\\pipe\\file_search.\n\n"
+                        "Another file search server is probably running.",
+                        "Startup Error", MB_ICONERROR | MB_OK);
+        }
+        return rc;
+    }
 
     CoInitialize(NULL);
 
@@ -2,34 +2,186 @@
  * results.c
  * Handles recording and displaying search results.
  * Owns all interaction with the results list-box and the found-path buffer.
+ * Matches are collected while the search runs and shown, sorted and
+ * without duplicates, once it finishes.
  */
 
 #include <windows.h>
+#include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
 
-#define PATH_CAP 32768
+#define PATH_CAP    32768
+#define SORT_FAILED ((size_t)-1)   /* paths_sort_unique ran out of memory */
 
 /* Shared state - defined in main.c, used here */
 extern char g_found_path[PATH_CAP];
 extern HWND g_hList;
 
+/* Function from sort.c */
+extern size_t paths_sort_unique(const char **paths, size_t count,
+                                int by_name, int fold_case);
+
+/* Collected matches: every path packed into one block, plus offsets.
+ * Offsets rather than pointers because the block moves as it grows. */
+static char   *g_result_text     = NULL;
+static size_t  g_result_text_len = 0;
+static size_t  g_result_text_cap = 0;
+static size_t *g_result_at       = NULL;
+static size_t  g_result_count    = 0;
+static size_t  g_result_cap      = 0;
+
+/* -------------------------------------------------------------------------
+ * Internal helpers (static)
+ * ---------------------------------------------------------------------- */
+
+static void collected_free(void)
+{
+    free(g_result_text);
+    free(g_result_at);
+    g_result_text     = NULL;
+    g_result_text_len = 0;
+    g_result_text_cap = 0;
+    g_result_at       = NULL;
+    g_result_count    = 0;
+    g_result_cap      = 0;
+}
+
+/* Returns 0 if out of memory */
+static int collect(const char *full_path)
+{
+    size_t len = strlen(full_path) + 1;
+
+    if (g_result_text_len + len > g_result_text_cap) {
+        size_t new_cap = (g_result_text_cap != 0) ? g_result_text_cap * 2 : 65536;
+        while (new_cap < g_result_text_len + len) {
+            new_cap *= 2;
+        }
+        char *grown = (char *)realloc(g_result_text, new_cap);
+        if (grown == NULL) {
+            return 0;
+        }
+        g_result_text     = grown;
+        g_result_text_cap = new_cap;
+    }
+    if (g_result_count == g_result_cap) {
+        size_t new_cap = (g_result_cap != 0) ? g_result_cap * 2 : 1024;
+        size_t *grown = (size_t *)realloc(g_result_at, new_cap * sizeof(*grown));
+        if (grown == NULL) {
+            return 0;
+        }
+        g_result_at  = grown;
+        g_result_cap = new_cap;
+    }
+
+    memcpy(g_result_text + g_result_text_len, full_path, len);
+    g_result_at[g_result_count++] = g_result_text_len;
+    g_result_text_len += len;
+    return 1;
+}
+
 /* -------------------------------------------------------------------------
  * Public functions
  * ---------------------------------------------------------------------- */
 
 void result_add(const char *full_path)
 {
-    if (g_hList != NULL) {
+    if (!collect(full_path) && g_hList != NULL) {
+        /* No memory to hold it for sorting - show it right away instead */
         SendMessageA(g_hList, LB_ADDSTRING, 0, (LPARAM)full_path);
     }
     strncpy(g_found_path, full_path, PATH_CAP - 1);
     g_found_path[PATH_CAP - 1] = '\0';
 }
 
+/* Per-directory count mode: records "dir  (count)". Collected and sorted
+ * like a path, so the lines come out in directory order. */
+void result_add_dir_count(const char *dir, size_t count)
+{
+    char line[PATH_CAP + 32];
+    snprintf(line, sizeof(line), "%s  (%lu)", dir, (unsigned long)count);
+    if (!collect(line) && g_hList != NULL) {
+        SendMessageA(g_hList, LB_ADDSTRING, 0, (LPARAM)line);
+    }
+}
+
+/* Called once the search is over. Sorts the collected paths by full
+ * path, ignoring case like Windows does, drops duplicates, and adds
+ * them to the list box in one go. */
+void results_flush(void)
+{
+    if (g_result_count == 0) {
+        collected_free();
+        return;
+    }
+
+    const char **paths = (const char **)malloc(g_result_count * sizeof(*paths));
+    size_t count = g_result_count;
+    size_t i;
+
+    if (paths != NULL) {
+        for (i = 0; i < count; ++i) {
+            paths[i] = g_result_text + g_result_at[i];
+        }
+        size_t kept = paths_sort_unique(paths, count, 0, 1);
+        if (kept != SORT_FAILED) {
+            count = kept;
+        } /* else show them unsorted, in the order they were found */
+    }
+
+    if (g_hList != NULL) {
+        SendMessageA(g_hList, WM_SETREDRAW, FALSE, 0);
+        SendMessageA(g_hList, LB_INITSTORAGE, (WPARAM)count,
+                     (LPARAM)g_result_text_len);
+        for (i = 0; i < count; ++i) {
+            const char *path = (paths != NULL) ? paths[i]
+                                               : g_result_text + g_result_at[i];
+            SendMessageA(g_hList, LB_ADDSTRING, 0, (LPARAM)path);
+        }
+        SendMessageA(g_hList, WM_SETREDRAW, TRUE, 0);
+        InvalidateRect(g_hList, NULL, TRUE);
+    }
+
+    free(paths);
+    collected_free();
+}
+
 void results_clear(void)
 {
     SendMessageA(g_hList, LB_RESETCONTENT, 0, 0);
     g_found_path[0] = '\0';
+    collected_free();
+}
+
+void results_show_count(size_t count)
+{
+    char line[64];
+    snprintf(line, sizeof(line), "%lu matching files.", (unsigned long)count);
+    SendMessageA(g_hList, LB_ADDSTRING, 0, (LPARAM)line);
+}
+
+/* One line of the "largest folders" report, e.g.
+ * "#1  1.4 GB in 3021 files  C:\Data\Video" */
+void results_show_subtree(size_t rank, const char *dir,
+                          unsigned long long files, unsigned long long bytes)
+{
+    static const char *units[] = { "bytes", "KB", "MB", "GB", "TB" };
+    double size = (double)bytes;
+    int    unit = 0;
+    char   line[PATH_CAP + 64];
+
+    while (size >= 1024.0 && unit < 4) {
+        size /= 1024.0;
+        ++unit;
+    }
+    if (unit == 0) {
+        snprintf(line, sizeof(line), "#%lu  %llu bytes in %llu files  %s",
+                 (unsigned long)rank, bytes, files, dir);
+    } else {
+        snprintf(line, sizeof(line), "#%lu  %.1f %s in %llu files  %s",
+                 (unsigned long)rank, size, units[unit], files, dir);
+    }
+    SendMessageA(g_hList, LB_ADDSTRING, 0, (LPARAM)line);
 }
 
 void results_show_not_found(void)
@@ -1,11 +1,13 @@
 /*
  * search.c
- * Recursive directory traversal and filename-prefix matching.
+ * Best-first directory traversal and filename-prefix matching.
  * Calls result_add() from results.c to record each match.
  */
 
 #include <windows.h>
+#include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 
 #define PATH_CAP 32768
 
@@ -19,63 +21,589 @@ extern int  is_skippable_attr(DWORD attrs);
 /* Function from results.c */
 extern void result_add(const char *full_path);
 
+/* Functions from throttle.c */
+extern int    throttle_active          (void);
+extern void   throttle_enter_background(void);
+extern void   throttle_leave_background(void);
+extern void   throttle_wait_dir        (void);
+extern void   throttle_charge_open     (double open_ms);
+extern void   throttle_charge_entries  (double entries);
+extern double throttle_now_ms          (void);
+
+/* Functions from aggregate.c */
+extern void *agg_add_dir  (void *tree, void *parent, const char *path);
+extern void  agg_add_files(void *node, unsigned long long files,
+                           unsigned long long bytes);
+
+/* Best-first tuning. A directory's priority is its depth minus bonuses;
+ * the lowest value is listed next. */
+#define PRIO_PER_LEVEL     1.0
+#define PRIO_NAME_HINT     1.5  /* directory name starts with the term  */
+#define PRIO_HISTORY_MAX   3.0  /* directory led to matches before      */
+
+/* Hit history: directories that produced matches in recent searches */
+#define HISTORY_SLOTS      4096 /* power of two                         */
+#define HISTORY_DECAY      0.8  /* weight kept per later search         */
+#define HISTORY_MAX_AGE    32   /* older hits count as nothing          */
+#define HISTORY_ROOT_SLOTS 256  /* per-root search counters, power of two */
+
+/* What the walk does with matches. Only SINK_PATHS ever builds the
+ * full path of a file; the others just count names. */
+#define SINK_PATHS       0   /* hand each full path to on_match        */
+#define SINK_COUNT       1   /* count every match                      */
+#define SINK_EXISTS      2   /* stop at the first match                */
+#define SINK_DIR_COUNTS  3   /* report a count per directory to on_dir */
+
+/* Called for every matching file. name points into full_path. */
+typedef void (*match_fn)(const char *full_path, const char *name, void *ctx);
+
+/* Called once for every directory holding at least one match */
+typedef void (*dir_count_fn)(const char *dir, size_t count, void *ctx);
+
+/* Everything that stays the same for the whole walk, passed by pointer
+ * so the walk does not have to carry each value separately. */
+struct search_job {
+    const char *term;
+    const char *hint;        /* names worth reaching first, usually term */
+    int         stop_after_first;
+    int        *found;
+    int         sink;        /* one of the SINK_ values                */
+    size_t     *total;       /* running match count, may be NULL       */
+    match_fn    on_match;    /* SINK_PATHS only                        */
+    dir_count_fn on_dir;     /* SINK_DIR_COUNTS only                   */
+    void       *ctx;
+    int         throttled;   /* pace the walk through throttle.c       */
+    void       *agg;         /* aggregate.c tree for folder sizes      */
+    int         agg_matches_only; /* size only the matching files     */
+    int         learn;       /* record and use hit history for hint    */
+    unsigned long generation;/* this search's hit-history generation  */
+    size_t      root_len;    /* history credit stops at the root       */
+};
+
+/* A directory waiting to be listed */
+struct pending_dir {
+    char          *path;
+    int            max_depth;
+    int            level;
+    double         priority;
+    unsigned long  seq;      /* ties go to the directory seen first    */
+    void          *agg_node; /* its aggregate.c node, or NULL          */
+    int            size_only;/* hidden: listed for folder sizes only   */
+};
+
+/* What list_dir learns about one directory while listing it */
+struct dir_tally {
+    size_t             matches;
+    size_t             hint_matches;
+    unsigned long long agg_files;
+    unsigned long long agg_bytes;
+};
+
+/* Binary min-heap of pending directories */
+struct dir_queue {
+    struct pending_dir *items;
+    size_t              count;
+    size_t              cap;
+    unsigned long       next_seq;
+};
+
+struct history_slot {
+    unsigned long long hash;
+    unsigned long      generation;
+    double             score;
+};
+
+/* How many searches a root has had. History only ages with searches of
+ * its own root, so queries against other roots cannot wipe it out. */
+struct history_root {
+    unsigned long long hash;
+    unsigned long      generation;
+};
+
+/* Set once FindFirstFileExA has refused the fast listing options for a
+ * pattern FindFirstFileA accepts (Windows before 7); every later listing
+ * then uses FindFirstFileA. */
+static volatile LONG g_plain_listing = 0;
+
+static struct history_slot g_history[HISTORY_SLOTS];
+static struct history_root g_history_roots[HISTORY_ROOT_SLOTS];
+static unsigned long       g_history_high = 0;  /* highest generation issued */
+static SRWLOCK             g_history_lock = SRWLOCK_INIT;
+
 /* -------------------------------------------------------------------------
  * Internal helpers (static - not visible outside this file)
  * ---------------------------------------------------------------------- */
 
-/* Forward declaration so process_entry can recurse */
-static void search_dir_depth(const char *root_dir, const char *term,
-                              int stop_after_first, int *found, int max_depth);
+/* FNV-1a over the first len bytes, folding case and slash direction so
+ * that "C:\Data" and "c:/data" land in the same slot. */
+static unsigned long long history_hash(const char *path, size_t len)
+{
+    unsigned long long h = 14695981039346656037ULL;
+    size_t i;
+    for (i = 0; i < len; ++i) {
+        unsigned char c = (unsigned char)tolower((unsigned char)path[i]);
+        if (c == '/') {
+            c = '\\';
+        }
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
 
-static void process_entry(const WIN32_FIND_DATAA *fd, const char *parent_dir,
-                           const char *term, int stop_after_first,
-                           int *found, int max_depth)
+static double history_decayed(const struct history_slot *slot,
+                              unsigned long generation)
 {
-    const char *name = fd->cFileName;
+    double score = slot->score;
+    if (slot->generation >= generation) {
+        return score; /* credited by this or a newer, concurrent search */
+    }
+    unsigned long age = generation - slot->generation;
+    if (age > HISTORY_MAX_AGE) {
+        return 0.0;
+    }
+    while (age-- > 0) {
+        score *= HISTORY_DECAY;
+    }
+    return score;
+}
+
+static double history_bonus(const char *path, unsigned long generation)
+{
+    unsigned long long h = history_hash(path, strlen(path));
+    double score = 0.0;
+
+    AcquireSRWLockShared(&g_history_lock);
+    const struct history_slot *slot = &g_history[h & (HISTORY_SLOTS - 1)];
+    if (slot->hash == h) {
+        score = history_decayed(slot, generation);
+    }
+    ReleaseSRWLockShared(&g_history_lock);
+
+    /* Grows with repeated hits but never past PRIO_HISTORY_MAX */
+    return PRIO_HISTORY_MAX * score / (score + 1.0);
+}
+
+/* Credits dir and every ancestor below the search root, so the next
+ * search of this root is steered down the whole route to the match. */
+static void history_credit(const char *dir, size_t root_len,
+                           unsigned long generation)
+{
+    size_t len = strlen(dir);
+
+    AcquireSRWLockExclusive(&g_history_lock);
+    while (len > root_len) {
+        unsigned long long h = history_hash(dir, len);
+        struct history_slot *slot = &g_history[h & (HISTORY_SLOTS - 1)];
+        if (slot->hash == h) {
+            slot->score = history_decayed(slot, generation) + 1.0;
+            if (slot->generation < generation) {
+                slot->generation = generation; /* never move it backwards */
+            }
+        } else {
+            slot->hash       = h;   /* direct-mapped: newest entry wins */
+            slot->score      = 1.0;
+            slot->generation = generation;
+        }
+
+        while (len > root_len && dir[len - 1] != '\\' && dir[len - 1] != '/') {
+            --len;
+        }
+        while (len > root_len && (dir[len - 1] == '\\' || dir[len - 1] == '/')) {
+            --len;
+        }
+    }
+    ReleaseSRWLockExclusive(&g_history_lock);
+}
+
+/* Starts one more search of root_dir and returns its generation. A root
+ * that takes over a counter slot starts above every generation issued so
+ * far, so old entries never look newer than its searches. */
+static unsigned long history_next_generation(const char *root_dir)
+{
+    size_t len = strlen(root_dir);
+    while (len > 0 && (root_dir[len - 1] == '\\' || root_dir[len - 1] == '/')) {
+        --len; /* "C:\Data\" and "C:\Data" are the same root */
+    }
+    unsigned long long h = history_hash(root_dir, len);
+
+    AcquireSRWLockExclusive(&g_history_lock);
+    struct history_root *root = &g_history_roots[h & (HISTORY_ROOT_SLOTS - 1)];
+    if (root->hash != h) {
+        root->hash       = h;
+        root->generation = g_history_high;
+    }
+    unsigned long generation = ++root->generation;
+    if (generation > g_history_high) {
+        g_history_high = generation;
+    }
+    ReleaseSRWLockExclusive(&g_history_lock);
+    return generation;
+}
+
+static int pending_before(const struct pending_dir *a, const struct pending_dir *b)
+{
+    if (a->priority != b->priority) {
+        return a->priority < b->priority;
+    }
+    return a->seq < b->seq;
+}
+
+/* Copies path into the queue. Returns 0 if out of memory. */
+static int queue_push(struct dir_queue *q, const char *path,
+                      int max_depth, int level, double priority, void *agg_node,
+                      int size_only)
+{
+    if (q->count == q->cap) {
+        size_t new_cap = (q->cap != 0) ? q->cap * 2 : 64;
+        struct pending_dir *grown = (struct pending_dir *)
+            realloc(q->items, new_cap * sizeof(*grown));
+        if (grown == NULL) {
+            return 0;
+        }
+        q->items = grown;
+        q->cap   = new_cap;
+    }
+    size_t len = strlen(path) + 1;
+    char *copy = (char *)malloc(len);
+    if (copy == NULL) {
+        return 0;
+    }
+    memcpy(copy, path, len);
+
+    struct pending_dir item;
+    item.path      = copy;
+    item.max_depth = max_depth;
+    item.level     = level;
+    item.priority  = priority;
+    item.seq       = q->next_seq++;
+    item.agg_node  = agg_node;
+    item.size_only = size_only;
+
+    size_t i = q->count++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!pending_before(&item, &q->items[parent])) {
+            break;
+        }
+        q->items[i] = q->items[parent];
+        i = parent;
+    }
+    q->items[i] = item;
+    return 1;
+}
+
+/* Removes the best directory. The caller frees out->path. */
+static int queue_pop(struct dir_queue *q, struct pending_dir *out)
+{
+    if (q->count == 0) {
+        return 0;
+    }
+    *out = q->items[0];
+    struct pending_dir last = q->items[--q->count];
+
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= q->count) {
+            break;
+        }
+        if (child + 1 < q->count &&
+            pending_before(&q->items[child + 1], &q->items[child])) {
+            ++child;
+        }
+        if (!pending_before(&q->items[child], &last)) {
+            break;
+        }
+        q->items[i] = q->items[child];
+        i = child;
+    }
+    if (q->count > 0) {
+        q->items[i] = last;
+    }
+    return 1;
+}
+
+static void queue_free(struct dir_queue *q)
+{
+    size_t i;
+    for (i = 0; i < q->count; ++i) {
+        free(q->items[i].path);
+    }
+    free(q->items);
+}
+
+/* Forward declaration so a directory that cannot be queued is walked
+ * on the spot instead of being lost */
+static void search_dir_depth(const char *root_dir, const struct search_job *job,
+                              int max_depth, void *agg_node, int size_only);
 
+/* 1 if the job reports the size of every file, hidden ones included */
+static int job_sizes_all(const struct search_job *job)
+{
+    return job->agg != NULL && !job->agg_matches_only;
+}
+
+/* The full path is only built once it is known to be needed: for a
+ * directory that will be queued, or for a matching file when the caller
+ * asked for paths. Most entries of a selective search need neither.
+ * A size_only entry is hidden from the search and is only looked at to
+ * add up folder sizes. */
+static void process_entry(const WIN32_FIND_DATAA *fd, const struct pending_dir *parent,
+                           const struct search_job *job, struct dir_queue *queue,
+                           struct dir_tally *tally, int size_only)
+{
+    const char *parent_dir = parent->path;
+    int max_depth = parent->max_depth;
+    int level = parent->level;
+    const char *name = fd->cFileName;
     char full_path[PATH_CAP];
-    path_join(full_path, sizeof(full_path), parent_dir, name);
 
     if ((fd->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0) {
-        /* Skip hidden dot-directories like ".git" */
+        /* Hidden dot-directories like ".git" are not searched */
         if (name[0] == '.') {
+            size_only = 1;
+        }
+        /* Hidden links such as "Application Data" point back into the
+         * tree; following them would count the same files twice */
+        if (size_only && (!job_sizes_all(job) ||
+                          (fd->dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0)) {
             return;
         }
         if (max_depth != 0) {
+            path_join(full_path, sizeof(full_path), parent_dir, name);
             int next_depth = (max_depth > 0) ? max_depth - 1 : max_depth;
-            search_dir_depth(full_path, term, stop_after_first, found, next_depth);
+            double priority = (level + 1) * PRIO_PER_LEVEL;
+            if (job->learn && !size_only) {
+                if (str_starts_with_icase(name, job->hint)) {
+                    priority -= PRIO_NAME_HINT;
+                }
+                priority -= history_bonus(full_path, job->generation);
+            }
+            void *agg_node = NULL;
+            if (parent->agg_node != NULL) {
+                agg_node = agg_add_dir(job->agg, parent->agg_node, full_path);
+                if (agg_node == NULL) {
+                    agg_node = parent->agg_node; /* out of memory: fold into parent */
+                }
+            }
+            if (!queue_push(queue, full_path, next_depth, level + 1, priority,
+                            agg_node, size_only)) {
+                search_dir_depth(full_path, job, next_depth, agg_node, size_only);
+            }
+        }
+    } else if (size_only) {
+        if (job_sizes_all(job)) {
+            tally->agg_files += 1;
+            tally->agg_bytes += ((unsigned long long)fd->nFileSizeHigh << 32) |
+                                fd->nFileSizeLow;
         }
     } else {
-        if (str_starts_with_icase(name, term)) {
-            result_add(full_path);
-            *found = 1;
+        int matched = str_starts_with_icase(name, job->term);
+        if (job->learn && (job->hint == job->term ? matched
+                                                  : str_starts_with_icase(name, job->hint))) {
+            tally->hint_matches += 1;
+        }
+        if (job->agg != NULL && (matched || !job->agg_matches_only)) {
+            tally->agg_files += 1;
+            tally->agg_bytes += ((unsigned long long)fd->nFileSizeHigh << 32) |
+                                fd->nFileSizeLow;
+        }
+        if (!matched) {
+            return;
         }
+        *job->found = 1;
+        tally->matches += 1;
+        if (job->sink == SINK_PATHS) {
+            path_join(full_path, sizeof(full_path), parent_dir, name);
+            size_t name_len = strlen(name);
+            size_t path_len = strlen(full_path);
+            const char *path_name = (path_len >= name_len)
+                                  ? full_path + path_len - name_len
+                                  : full_path;
+            job->on_match(full_path, path_name, job->ctx);
+        }
+    }
+}
+
+/* Opens a directory listing. FindExInfoBasic skips the 8.3 short names
+ * nothing here uses, and FIND_FIRST_EX_LARGE_FETCH has the file system
+ * return entries in larger batches, so big and remote directories need
+ * fewer round trips. Sizes, times and attributes come back with every
+ * entry either way, so no per-file call is ever needed. */
+static HANDLE open_listing(const char *pattern, WIN32_FIND_DATAA *fd)
+{
+    if (g_plain_listing) {
+        return FindFirstFileA(pattern, fd);
     }
+    HANDLE h = FindFirstFileExA(pattern, FindExInfoBasic, fd,
+                                FindExSearchNameMatch, NULL,
+                                FIND_FIRST_EX_LARGE_FETCH);
+    if (h != INVALID_HANDLE_VALUE || GetLastError() != ERROR_INVALID_PARAMETER) {
+        return h;
+    }
+    /* ERROR_INVALID_PARAMETER can also mean the pattern itself is bad.
+     * Only blame the options if the plain call accepts the same pattern. */
+    h = FindFirstFileA(pattern, fd);
+    if (h != INVALID_HANDLE_VALUE) {
+        InterlockedExchange(&g_plain_listing, 1);
+    }
+    return h;
 }
 
-static void search_dir_depth(const char *root_dir, const char *term,
-                              int stop_after_first, int *found, int max_depth)
+/* Lists one directory: reports its matching files and queues its
+ * subdirectories. */
+static void list_dir(const struct pending_dir *dir, const struct search_job *job,
+                     struct dir_queue *queue)
 {
     char pattern[PATH_CAP];
-    path_make_pattern(pattern, sizeof(pattern), root_dir);
+    path_make_pattern(pattern, sizeof(pattern), dir->path);
+
+    double opened_at = 0.0;
+    if (job->throttled) {
+        throttle_wait_dir();
+        opened_at = throttle_now_ms();
+    }
 
     WIN32_FIND_DATAA fd;
-    HANDLE h = FindFirstFileA(pattern, &fd);
+    HANDLE h = open_listing(pattern, &fd);
+    if (job->throttled) {
+        throttle_charge_open(throttle_now_ms() - opened_at);
+    }
     if (h == INVALID_HANDLE_VALUE) {
         return;
     }
 
+    struct dir_tally tally;
+    memset(&tally, 0, sizeof(tally));
+    size_t listed = 0;
     do {
-        if (stop_after_first && *found) {
+        if (job->stop_after_first && *job->found) {
             break;
         }
-        if (is_dot_entry(fd.cFileName) || is_skippable_attr(fd.dwFileAttributes)) {
+        ++listed;
+        if (is_dot_entry(fd.cFileName)) {
             continue;
         }
-        process_entry(&fd, root_dir, term, stop_after_first, found, max_depth);
+        int hidden = dir->size_only || is_skippable_attr(fd.dwFileAttributes);
+        if (hidden && !job_sizes_all(job)) {
+            continue;
+        }
+        process_entry(&fd, dir, job, queue, &tally, hidden);
     } while (FindNextFileA(h, &fd));
 
     FindClose(h);
+
+    /* One charge per folder: the bucket sits behind a process-wide lock,
+     * and the next throttle_wait_dir settles any debt either way */
+    if (job->throttled) {
+        throttle_charge_entries((double)listed);
+    }
+    if (dir->agg_node != NULL) {
+        agg_add_files(dir->agg_node, tally.agg_files, tally.agg_bytes);
+    }
+    if (tally.hint_matches > 0) {
+        history_credit(dir->path, job->root_len, job->generation);
+    }
+    if (tally.matches == 0) {
+        return;
+    }
+    if (job->total != NULL) {
+        *job->total += tally.matches;
+    }
+    if (job->sink == SINK_DIR_COUNTS) {
+        job->on_dir(dir->path, tally.matches, job->ctx);
+    }
+}
+
+/* Best-first walk. Every directory under root_dir is still listed, only
+ * the order changes: shallow directories, directories whose names look
+ * like the term, and directories that held matches in recent searches
+ * go first, so the first results show up early. */
+static void search_dir_depth(const char *root_dir, const struct search_job *job,
+                              int max_depth, void *agg_node, int size_only)
+{
+    struct dir_queue   queue;
+    struct pending_dir dir;
+
+    memset(&queue, 0, sizeof(queue));
+
+    if (!queue_push(&queue, root_dir, max_depth, 0, 0.0, agg_node, size_only)) {
+        return;
+    }
+    while (queue_pop(&queue, &dir)) {
+        list_dir(&dir, job, &queue);
+        free(dir.path);
+        if (job->stop_after_first && *job->found) {
+            break;
+        }
+    }
+    queue_free(&queue);
+}
+
+/* Adapter so the GUI searches keep going through results.c */
+static void add_to_results(const char *full_path, const char *name, void *ctx)
+{
+    (void)name;
+    (void)ctx;
+    result_add(full_path);
+}
+
+/* Sets up a SINK_PATHS job; the count modes adjust it afterwards */
+static void job_init(struct search_job *job, const char *root_dir,
+                     const char *term, int *found, match_fn on_match, void *ctx)
+{
+    job->term             = term;
+    job->hint             = term;
+    job->stop_after_first = 0;
+    job->found            = found;
+    job->sink             = SINK_PATHS;
+    job->total            = NULL;
+    job->on_match         = on_match;
+    job->on_dir           = NULL;
+    job->ctx              = ctx;
+    job->throttled        = 0;
+    job->agg              = NULL;
+    job->agg_matches_only = 0;
+    /* An empty term matches everything, which teaches nothing */
+    job->learn            = (term != NULL && term[0] != '\0');
+    job->generation       = job->learn ? history_next_generation(root_dir) : 0;
+    job->root_len         = strlen(root_dir);
+}
+
+/* Steers the walk toward names starting with hint without changing what
+ * counts as a match. A NULL or empty hint turns steering off. */
+static void job_set_hint(struct search_job *job, const char *root_dir,
+                         const char *hint)
+{
+    job->hint  = (hint != NULL) ? hint : "";
+    job->learn = (job->hint[0] != '\0');
+    if (job->learn && job->generation == 0) {
+        job->generation = history_next_generation(root_dir);
+    }
+}
+
+/* Unlimited-depth walk that becomes a background crawl once
+ * throttle_configure has been called. Only the server configures the
+ * throttle, so searches from the window still run at full speed. */
+static void run_paced(const char *root_dir, struct search_job *job)
+{
+    job->throttled = throttle_active();
+    if (job->throttled) {
+        throttle_enter_background();
+    }
+    search_dir_depth(root_dir, job, -1, NULL, 0);
+    if (job->throttled) {
+        throttle_leave_background();
+    }
+}
+
+static void run_search(const char *root_dir, const char *term, int *found,
+                       int max_depth, match_fn on_match, void *ctx)
+{
+    struct search_job job;
+    job_init(&job, root_dir, term, found, on_match, ctx);
+    search_dir_depth(root_dir, &job, max_depth, NULL, 0);
 }
 
 /* -------------------------------------------------------------------------
@@ -84,10 +612,94 @@ static void search_dir_depth(const char *root_dir, const char *term,
 
 void search_directory_all(const char *root_dir, const char *term, int *found)
 {
-    search_dir_depth(root_dir, term, 0, found, -1); /* -1 = unlimited depth */
+    run_search(root_dir, term, found, -1, add_to_results, NULL); /* -1 = unlimited depth */
 }
 
 void search_directory_shallow(const char *root_dir, const char *term, int *found)
 {
-    search_dir_depth(root_dir, term, 0, found, 0);  /*  0 = root only      */
+    run_search(root_dir, term, found, 0, add_to_results, NULL);  /*  0 = root only      */
+}
+
+/* Same walk as search_directory_all, but hands every match to on_match
+ * instead of the list box. Used by server.c to fill its name cache.
+ * hint (may be NULL) is what the caller is really after: directories
+ * likely to hold names starting with it are listed first, even though
+ * every name matching term is still reported. Safe to call from several
+ * threads at once.
+ * Runs as a background crawl when throttle_configure has been called. */
+void search_directory_each(const char *root_dir, const char *term,
+                           const char *hint,
+                           void (*on_match)(const char *full_path,
+                                            const char *name, void *ctx),
+                           void *ctx)
+{
+    struct search_job job;
+    int found = 0;
+
+    job_init(&job, root_dir, term, &found, on_match, ctx);
+    job_set_hint(&job, root_dir, hint);
+    run_paced(root_dir, &job);
+}
+
+/* Number of matching files under root_dir. No paths are built.
+ * Used by server.c for roots it has not cached, and paced like
+ * search_directory_each. */
+size_t search_count_all(const char *root_dir, const char *term)
+{
+    struct search_job job;
+    int    found = 0;
+    size_t total = 0;
+
+    job_init(&job, root_dir, term, &found, NULL, NULL);
+    job.sink  = SINK_COUNT;
+    job.total = &total;
+    run_paced(root_dir, &job);
+    return total;
+}
+
+/* 1 if any file under root_dir matches. Stops at the first one. */
+int search_exists(const char *root_dir, const char *term)
+{
+    struct search_job job;
+    int found = 0;
+
+    job_init(&job, root_dir, term, &found, NULL, NULL);
+    job.sink             = SINK_EXISTS;
+    job.stop_after_first = 1;
+    run_paced(root_dir, &job);
+    return found;
+}
+
+/* Calls on_dir once for every directory under root_dir that holds
+ * matching files, with how many it holds. Returns the total. Only the
+ * directory paths the walk already has are passed; no file path is built. */
+size_t search_count_per_dir(const char *root_dir, const char *term,
+                            void (*on_dir)(const char *dir, size_t count,
+                                           void *ctx),
+                            void *ctx)
+{
+    struct search_job job;
+    int    found = 0;
+    size_t total = 0;
+
+    job_init(&job, root_dir, term, &found, NULL, ctx);
+    job.sink   = SINK_DIR_COUNTS;
+    job.total  = &total;
+    job.on_dir = on_dir;
+    run_paced(root_dir, &job);
+    return total;
+}
+
+/* search_directory_all that also adds up file counts and sizes for every
+ * folder into tree (from agg_create), in the same walk. With matches_only
+ * set, only the matching files are counted. */
+void search_directory_sizes(const char *root_dir, const char *term, int *found,
+                            int matches_only, void *tree)
+{
+    struct search_job job;
+
+    job_init(&job, root_dir, term, found, add_to_results, NULL);
+    job.agg              = tree;
+    job.agg_matches_only = matches_only;
+    search_dir_depth(root_dir, &job, -1, agg_add_dir(tree, NULL, root_dir), 0);
 }
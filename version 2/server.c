@@ -0,0 +1,918 @@
+/*
+ * server.c
+ * Resident search server, started with "file_search.exe /serve".
+ * Keeps the file names under recently queried roots in memory and answers
+ * queries from other processes over a named pipe, so scripts do not pay
+ * for process startup and a cold directory walk on every lookup.
+ *
+ * Protocol: plain text, one request per line, any number of requests per
+ * connection. Fields are separated by a tab (not allowed in file names).
+ *
+ *     FIND<TAB>root<TAB>prefix[<TAB>order]
+ *                                one matching path per line, then "OK <count> <age>"
+ *     COUNT<TAB>root<TAB>prefix  "OK <count> <age>" only
+ *     EXISTS<TAB>root<TAB>prefix "OK 1 <age>" or "OK 0 <age>"
+ *     DIRCOUNT<TAB>root<TAB>prefix
+ *                                "<count><TAB>dir" per directory holding
+ *                                matches, then "OK <total> <age>"
+ *     DROP<TAB>root              forget the cached names, then "OK 0"
+ *
+ * <age> is how many seconds old the cached names behind the answer are.
+ * Tables older than SERVER_CACHE_TTL_MS are walked again on next use.
+ *
+ * Without an order, paths from a cached root come sorted by file name,
+ * ignoring case. For a root that is not cached yet they are streamed in
+ * the order the walk finds them, and the same file can appear twice if
+ * the walk reaches it twice (through a link, say). The order names are
+ * "path" and "name" (file name, then path), or "ipath" and "iname" to
+ * ignore case; sorted replies never repeat a path.
+ *
+ * Anything else gets "ERR <reason>".
+ */
+
+#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+
+#define PATH_CAP       32768
+#define ROOT_INPUT_CAP  4096
+#define TERM_INPUT_CAP   512
+
+#define SERVER_PIPE_NAME     "\\\\.\\pipe\\file_search"
+#define SERVER_PIPE_BUF      65536
+#define SERVER_CACHE_SLOTS   8
+#define SERVER_CACHE_TTL_MS  (5 * 60 * 1000)
+#define SERVER_STREAM_FLUSH_MS 100
+#define SERVER_LINE_CAP      (ROOT_INPUT_CAP + TERM_INPUT_CAP + 16)
+#define SORT_FAILED          ((size_t)-1)  /* paths_sort_unique ran out of memory */
+
+/* Functions from utils.c */
+extern int str_equals_icase     (const char *a, const char *b);
+extern int str_starts_with_icase(const char *text, const char *prefix);
+
+/* Function from sort.c */
+extern size_t paths_sort_unique(const char **paths, size_t count,
+                                int by_name, int fold_case);
+
+/* Functions from search.c */
+extern void   search_directory_each(const char *root_dir, const char *term,
+                                    const char *hint,
+                                    void (*on_match)(const char *full_path,
+                                                     const char *name, void *ctx),
+                                    void *ctx);
+extern size_t search_count_all     (const char *root_dir, const char *term);
+extern int    search_exists        (const char *root_dir, const char *term);
+extern size_t search_count_per_dir (const char *root_dir, const char *term,
+                                    void (*on_dir)(const char *dir, size_t count,
+                                                   void *ctx),
+                                    void *ctx);
+
+/* -------------------------------------------------------------------------
+ * Buffered pipe output
+ * WriteFile blocks once the pipe's buffer is full, so a client that reads
+ * slowly stalls only its own thread instead of growing server memory.
+ * ---------------------------------------------------------------------- */
+
+struct pipe_writer {
+    HANDLE pipe;
+    int    failed;
+    size_t len;
+    char   buf[SERVER_PIPE_BUF];
+};
+
+static void writer_flush(struct pipe_writer *w)
+{
+    size_t sent = 0;
+    while (!w->failed && sent < w->len) {
+        DWORD wrote = 0;
+        if (!WriteFile(w->pipe, w->buf + sent, (DWORD)(w->len - sent),
+                       &wrote, NULL)) {
+            w->failed = 1;
+        }
+        sent += wrote;
+    }
+    w->len = 0;
+}
+
+static void writer_put(struct pipe_writer *w, const char *data, size_t len)
+{
+    while (!w->failed && len > 0) {
+        size_t room = sizeof(w->buf) - w->len;
+        size_t take = (len < room) ? len : room;
+        memcpy(w->buf + w->len, data, take);
+        w->len += take;
+        data   += take;
+        len    -= take;
+        if (w->len == sizeof(w->buf)) {
+            writer_flush(w);
+        }
+    }
+}
+
+static void writer_line(struct pipe_writer *w, const char *text)
+{
+    writer_put(w, text, strlen(text));
+    writer_put(w, "\n", 1);
+}
+
+/* -------------------------------------------------------------------------
+ * Name tables
+ * All paths under one root, packed into a single text block. Once built a
+ * table is never modified, so readers need no lock while scanning it; the
+ * reference count keeps it alive until the last reader lets go.
+ * by_name lists the entries sorted by file name, ignoring case, so a
+ * prefix query is two binary searches instead of a scan of every name.
+ * ---------------------------------------------------------------------- */
+
+struct name_entry {
+    size_t path_at;   /* offset of the full path in text */
+    size_t name_at;   /* offset of the file name in text */
+};
+
+struct name_table {
+    char               root[ROOT_INPUT_CAP];
+    char              *text;
+    size_t             text_len;
+    size_t             text_cap;
+    struct name_entry *entries;
+    size_t             count;
+    size_t             cap;
+    size_t            *by_name;   /* entry indices, sorted by name     */
+    size_t             by_name_count;
+    ULONGLONG          built_at;  /* GetTickCount64 when walked        */
+    int                failed;    /* ran out of memory while building */
+    volatile LONG      refs;
+};
+
+static struct name_table *g_tables[SERVER_CACHE_SLOTS];
+static ULONGLONG          g_table_used[SERVER_CACHE_SLOTS];
+static ULONGLONG          g_use_clock = 0;
+static SRWLOCK            g_cache_lock = SRWLOCK_INIT;
+
+/* Roots being walked right now, so a second client asking for the same
+ * root waits on g_build_done instead of walking it again */
+struct build_note {
+    char                root[ROOT_INPUT_CAP];
+    struct build_note *next;
+};
+
+static struct build_note *g_builds = NULL;
+static CONDITION_VARIABLE  g_build_done = CONDITION_VARIABLE_INIT;
+
+static void table_free(struct name_table *t)
+{
+    free(t->text);
+    free(t->entries);
+    free(t->by_name);
+    free(t);
+}
+
+static void table_release(struct name_table *t)
+{
+    if (t != NULL && InterlockedDecrement(&t->refs) == 0) {
+        table_free(t);
+    }
+}
+
+static void table_add_path(const char *full_path, const char *name, void *ctx)
+{
+    struct name_table *t = (struct name_table *)ctx;
+    size_t len = strlen(full_path) + 1;
+
+    if (t->failed) {
+        return;
+    }
+    if (t->text_len + len > t->text_cap) {
+        size_t new_cap = (t->text_cap != 0) ? t->text_cap * 2 : 1 << 20;
+        while (new_cap < t->text_len + len) {
+            new_cap *= 2;
+        }
+        char *grown = (char *)realloc(t->text, new_cap);
+        if (grown == NULL) {
+            t->failed = 1;
+            return;
+        }
+        t->text     = grown;
+        t->text_cap = new_cap;
+    }
+    if (t->count == t->cap) {
+        size_t new_cap = (t->cap != 0) ? t->cap * 2 : 4096;
+        struct name_entry *grown = (struct name_entry *)
+            realloc(t->entries, new_cap * sizeof(*grown));
+        if (grown == NULL) {
+            t->failed = 1;
+            return;
+        }
+        t->entries = grown;
+        t->cap     = new_cap;
+    }
+
+    memcpy(t->text + t->text_len, full_path, len);
+    t->entries[t->count].path_at = t->text_len;
+    t->entries[t->count].name_at = t->text_len + (size_t)(name - full_path);
+    t->count    += 1;
+    t->text_len += len;
+}
+
+/* An unsorted FIND for a root that is not cached yet. Its matches are
+ * sent while the walk finds them, so the first ones reach the client
+ * long before the whole tree is listed. */
+struct find_stream {
+    struct pipe_writer *w;
+    const char         *term;
+    size_t              sent;
+    ULONGLONG           last_flush;
+    int                 walked;   /* the walk ran and streamed for us */
+};
+
+struct table_walk {
+    struct name_table  *t;
+    struct find_stream *stream;   /* may be NULL */
+};
+
+static void table_walk_add(const char *full_path, const char *name, void *ctx)
+{
+    struct table_walk *walk = (struct table_walk *)ctx;
+    struct find_stream *stream = walk->stream;
+
+    table_add_path(full_path, name, walk->t);
+    if (stream == NULL || !str_starts_with_icase(name, stream->term)) {
+        return;
+    }
+    writer_line(stream->w, full_path);
+    stream->sent += 1;
+    /* Flush now and then rather than per line: the first match goes out
+     * at once, later ones in batches */
+    ULONGLONG now = GetTickCount64();
+    if (stream->sent == 1 || now - stream->last_flush >= SERVER_STREAM_FLUSH_MS) {
+        writer_flush(stream->w);
+        stream->last_flush = now;
+    }
+}
+
+/* Entry whose path starts at text offset path_at. Entries are stored
+ * in text order, so a binary search finds it. */
+static size_t entry_at(const struct name_table *t, size_t path_at)
+{
+    size_t lo = 0;
+    size_t hi = t->count;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (t->entries[mid].path_at <= path_at) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Fills by_name. Returns 0 if out of memory. */
+static int table_index(struct name_table *t)
+{
+    const char **paths;
+    size_t i;
+
+    if (t->count == 0) {
+        return 1;
+    }
+    paths      = (const char **)malloc(t->count * sizeof(*paths));
+    t->by_name = (size_t *)malloc(t->count * sizeof(*t->by_name));
+    if (paths == NULL || t->by_name == NULL) {
+        free(paths);
+        return 0;
+    }
+    for (i = 0; i < t->count; ++i) {
+        paths[i] = t->text + t->entries[i].path_at;
+    }
+    t->by_name_count = paths_sort_unique(paths, t->count, 1, 1);
+    if (t->by_name_count == SORT_FAILED) {
+        /* An unsorted index would give wrong answers, not slow ones */
+        free(paths);
+        return 0;
+    }
+    for (i = 0; i < t->by_name_count; ++i) {
+        t->by_name[i] = entry_at(t, (size_t)(paths[i] - t->text));
+    }
+    free(paths);
+    return 1;
+}
+
+/* Walks root once with an empty prefix so every file is recorded.
+ * With a stream, the walk heads for the stream's prefix first and sends
+ * its matches as they turn up. */
+static struct name_table *table_build(const char *root, struct find_stream *stream)
+{
+    struct table_walk walk;
+
+    struct name_table *t = (struct name_table *)calloc(1, sizeof(*t));
+    if (t == NULL) {
+        return NULL;
+    }
+    strncpy(t->root, root, ROOT_INPUT_CAP - 1);
+    t->root[ROOT_INPUT_CAP - 1] = '\0';
+    t->refs = 1;
+
+    walk.t      = t;
+    walk.stream = stream;
+    if (stream != NULL) {
+        stream->walked = 1;
+    }
+    search_directory_each(root, "", (stream != NULL) ? stream->term : NULL,
+                          table_walk_add, &walk);
+    t->built_at = GetTickCount64();
+
+    if (t->failed || !table_index(t)) {
+        table_free(t);
+        return NULL;
+    }
+    return t;
+}
+
+/* Looks root up in the cache. Caller holds g_cache_lock. Returns a
+ * referenced table, or NULL; an expired table is taken out of its slot
+ * and handed back in *expired for the caller to release unlocked. */
+static struct name_table *cache_find_locked(const char *root,
+                                            struct name_table **expired)
+{
+    int i;
+
+    for (i = 0; i < SERVER_CACHE_SLOTS; ++i) {
+        if (g_tables[i] != NULL && str_equals_icase(g_tables[i]->root, root)) {
+            struct name_table *hit = g_tables[i];
+            if (GetTickCount64() - hit->built_at > SERVER_CACHE_TTL_MS) {
+                /* Too old to trust - forget it and walk again */
+                *expired    = hit;
+                g_tables[i] = NULL;
+                return NULL;
+            }
+            InterlockedIncrement(&hit->refs);
+            g_table_used[i] = ++g_use_clock;
+            return hit;
+        }
+    }
+    return NULL;
+}
+
+/* 1 if a client is walking root right now. Caller holds g_cache_lock. */
+static int build_running_locked(const char *root)
+{
+    const struct build_note *b;
+    for (b = g_builds; b != NULL; b = b->next) {
+        if (str_equals_icase(b->root, root)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Returns a referenced table for root if one is cached and not yet
+ * expired, otherwise NULL. Never walks the disk.
+ * The caller must hand it back with table_release. */
+static struct name_table *cache_lookup(const char *root)
+{
+    struct name_table *expired = NULL;
+
+    AcquireSRWLockExclusive(&g_cache_lock);
+    struct name_table *hit = cache_find_locked(root, &expired);
+    ReleaseSRWLockExclusive(&g_cache_lock);
+
+    table_release(expired);
+    return hit;
+}
+
+/* Returns a referenced table for root, walking the disk only on a miss.
+ * If another client is already walking the same root, waits for its
+ * table instead of walking the share a second time.
+ * stream (may be NULL) receives the matches of a miss as they are found.
+ * The caller must hand it back with table_release. */
+static struct name_table *cache_acquire(const char *root, struct find_stream *stream)
+{
+    struct name_table *expired = NULL;
+    struct name_table *hit;
+    int i;
+
+    AcquireSRWLockExclusive(&g_cache_lock);
+    for (;;) {
+        hit = cache_find_locked(root, &expired);
+        if (hit != NULL || !build_running_locked(root)) {
+            break;
+        }
+        SleepConditionVariableSRW(&g_build_done, &g_cache_lock, INFINITE, 0);
+    }
+    if (hit != NULL) {
+        ReleaseSRWLockExclusive(&g_cache_lock);
+        table_release(expired);
+        return hit;
+    }
+
+    /* Announce the walk so others wait for it. Without memory for the
+     * note they just walk too, which is slower but still correct. */
+    struct build_note *mine = (struct build_note *)malloc(sizeof(*mine));
+    if (mine != NULL) {
+        strncpy(mine->root, root, ROOT_INPUT_CAP - 1);
+        mine->root[ROOT_INPUT_CAP - 1] = '\0';
+        mine->next = g_builds;
+        g_builds   = mine;
+    }
+    ReleaseSRWLockExclusive(&g_cache_lock);
+    table_release(expired);
+
+    /* Walk without holding the lock so other roots stay answerable */
+    struct name_table *fresh = table_build(root, stream);
+
+    struct name_table *evicted = NULL;
+    int slot = 0;
+
+    AcquireSRWLockExclusive(&g_cache_lock);
+    if (mine != NULL) {
+        struct build_note **link = &g_builds;
+        while (*link != mine) {
+            link = &(*link)->next;
+        }
+        *link = mine->next;
+        free(mine);
+    }
+    /* Wake the waiters even if the walk failed; they then walk themselves */
+    WakeAllConditionVariable(&g_build_done);
+    if (fresh == NULL) {
+        ReleaseSRWLockExclusive(&g_cache_lock);
+        return NULL;
+    }
+    for (i = 0; i < SERVER_CACHE_SLOTS; ++i) {
+        if (g_tables[i] != NULL && str_equals_icase(g_tables[i]->root, root)) {
+            /* Another client built the same root meanwhile - keep theirs */
+            struct name_table *theirs = g_tables[i];
+            InterlockedIncrement(&theirs->refs);
+            g_table_used[i] = ++g_use_clock;
+            ReleaseSRWLockExclusive(&g_cache_lock);
+            table_release(fresh);
+            return theirs;
+        }
+        if (g_tables[i] == NULL ||
+            (g_tables[slot] != NULL && g_table_used[i] < g_table_used[slot])) {
+            slot = i;
+        }
+    }
+    evicted            = g_tables[slot];
+    g_tables[slot]     = fresh;
+    g_table_used[slot] = ++g_use_clock;
+    InterlockedIncrement(&fresh->refs); /* one for the cache, one for us */
+    ReleaseSRWLockExclusive(&g_cache_lock);
+
+    table_release(evicted);
+    return fresh;
+}
+
+static void cache_drop(const char *root)
+{
+    struct name_table *dropped = NULL;
+    int i;
+
+    AcquireSRWLockExclusive(&g_cache_lock);
+    for (i = 0; i < SERVER_CACHE_SLOTS; ++i) {
+        if (g_tables[i] != NULL && str_equals_icase(g_tables[i]->root, root)) {
+            dropped     = g_tables[i];
+            g_tables[i] = NULL;
+            break;
+        }
+    }
+    ReleaseSRWLockExclusive(&g_cache_lock);
+
+    table_release(dropped);
+}
+
+/* -------------------------------------------------------------------------
+ * Request handling
+ * ---------------------------------------------------------------------- */
+
+/* Asked only on a cache miss: a cached table already proves the root
+ * existed, and on a network share this check is a round trip. */
+static int is_valid_root(const char *root)
+{
+    DWORD attrs = GetFileAttributesA(root);
+    return (attrs != INVALID_FILE_ATTRIBUTES &&
+            (attrs & FILE_ATTRIBUTE_DIRECTORY) != 0);
+}
+
+/* Returns 0 for an unknown order name */
+static int parse_order(const char *order, int *sorted, int *by_name, int *fold_case)
+{
+    *sorted    = 1;
+    *fold_case = (order[0] == 'i' || order[0] == 'I');
+    if (*fold_case) {
+        ++order;
+    }
+    if (str_equals_icase(order, "path")) {
+        *by_name = 0;
+    } else if (str_equals_icase(order, "name")) {
+        *by_name = 1;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+/* Where name stands relative to the names starting with prefix: below
+ * them (< 0), among them (0) or above them (> 0). Folds case the same
+ * way paths_sort_unique does, so it agrees with the by_name order. */
+static int name_vs_prefix(const char *name, const char *prefix)
+{
+    for (; *prefix != '\0'; ++name, ++prefix) {
+        if (*name == '\0') {
+            return -1;
+        }
+        int a = tolower((unsigned char)*name);
+        int b = tolower((unsigned char)*prefix);
+        if (a != b) {
+            return a - b;
+        }
+    }
+    return 0;
+}
+
+/* First by_name position whose name compares at least want_above
+ * (0: first match, 1: first name past the matches). */
+static size_t lower_bound(const struct name_table *t, const char *prefix,
+                          int want_above)
+{
+    size_t lo = 0;
+    size_t hi = t->by_name_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const char *name = t->text + t->entries[t->by_name[mid]].name_at;
+        int r = name_vs_prefix(name, prefix);
+        if (want_above ? (r <= 0) : (r < 0)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* The matches for prefix are by_name[*first .. *last) */
+static void match_range(const struct name_table *t, const char *prefix,
+                        size_t *first, size_t *last)
+{
+    *first = lower_bound(t, prefix, 0);
+    *last  = lower_bound(t, prefix, 1);
+}
+
+static void writer_status(struct pipe_writer *w, size_t count,
+                          const struct name_table *t)
+{
+    char status[64];
+    unsigned long age = 0;
+    if (t != NULL) {
+        age = (unsigned long)((GetTickCount64() - t->built_at) / 1000);
+    }
+    snprintf(status, sizeof(status), "OK %lu %lu", (unsigned long)count, age);
+    writer_line(w, status);
+}
+
+/* Sorted reply: gathers pointers to the matches, which stay valid while
+ * the table is referenced, and streams them out once sorted.
+ * Returns 0 (after sending ERR) if out of memory. */
+static int send_sorted(struct pipe_writer *w, const struct name_table *t,
+                       size_t first, size_t last, int by_name, int fold_case,
+                       size_t *matches)
+{
+    const char **paths = (const char **)malloc((last - first + 1) * sizeof(*paths));
+    size_t count = 0;
+    size_t i;
+
+    if (paths == NULL) {
+        writer_line(w, "ERR out of memory");
+        return 0;
+    }
+    for (i = first; i < last; ++i) {
+        paths[count++] = t->text + t->entries[t->by_name[i]].path_at;
+    }
+    count = paths_sort_unique(paths, count, by_name, fold_case);
+    if (count == SORT_FAILED) {
+        free(paths);
+        writer_line(w, "ERR out of memory");
+        return 0;
+    }
+    for (i = 0; i < count && !w->failed; ++i) {
+        writer_line(w, paths[i]);
+    }
+    free(paths);
+    *matches = count;
+    return 1;
+}
+
+/* Length of the directory part of an entry's path, without the
+ * separator before the file name (kept for a drive root like "C:\"). */
+static size_t entry_dir_len(const struct name_table *t, const struct name_entry *e)
+{
+    size_t len = e->name_at - e->path_at;
+    const char *path = t->text + e->path_at;
+    if (len > 1 && path[len - 2] != ':') {
+        --len;
+    }
+    return len;
+}
+
+static int by_index(const void *a, const void *b)
+{
+    size_t x = *(const size_t *)a;
+    size_t y = *(const size_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* DIRCOUNT reply. The matches are put back in walk order, where the
+ * files of one directory sit next to each other, then counted in runs.
+ * Returns 0 (after sending ERR) if out of memory. */
+static int send_dir_counts(struct pipe_writer *w, const struct name_table *t,
+                           size_t first, size_t last)
+{
+    size_t  n = last - first;
+    size_t *order = (size_t *)malloc((n + 1) * sizeof(*order));
+    size_t  i;
+
+    if (order == NULL) {
+        writer_line(w, "ERR out of memory");
+        return 0;
+    }
+    memcpy(order, t->by_name + first, n * sizeof(*order));
+    qsort(order, n, sizeof(*order), by_index);
+
+    size_t run_start = 0;
+    for (i = 1; i <= n && !w->failed; ++i) {
+        const struct name_entry *a = &t->entries[order[run_start]];
+        size_t len = entry_dir_len(t, a);
+        if (i < n) {
+            const struct name_entry *b = &t->entries[order[i]];
+            if (entry_dir_len(t, b) == len &&
+                memcmp(t->text + a->path_at, t->text + b->path_at, len) == 0) {
+                continue;
+            }
+        }
+        char count_text[32];
+        snprintf(count_text, sizeof(count_text), "%lu\t",
+                 (unsigned long)(i - run_start));
+        writer_put(w, count_text, strlen(count_text));
+        writer_put(w, t->text + a->path_at, len);
+        writer_put(w, "\n", 1);
+        run_start = i;
+    }
+    free(order);
+    return 1;
+}
+
+/* DIRCOUNT line for a root that is not cached, straight from the walk.
+ * The root comes as the client typed it, so a trailing separator is
+ * dropped the same way entry_dir_len drops it, keeping "C:\". */
+static void write_dir_count(const char *dir, size_t count, void *ctx)
+{
+    struct pipe_writer *w = (struct pipe_writer *)ctx;
+    char count_text[32];
+    size_t len = strlen(dir);
+
+    if (len > 1 && (dir[len - 1] == '\\' || dir[len - 1] == '/') &&
+        dir[len - 2] != ':') {
+        --len;
+    }
+    snprintf(count_text, sizeof(count_text), "%lu\t", (unsigned long)count);
+    writer_put(w, count_text, strlen(count_text));
+    writer_put(w, dir, len);
+    writer_put(w, "\n", 1);
+}
+
+/* COUNT and DIRCOUNT. A cached root is answered from its name index.
+ * Otherwise the disk is walked in a counting mode that builds no paths
+ * and caches nothing: a count is no sign the names will be asked for. */
+static void handle_count(struct pipe_writer *w, const char *root,
+                         const char *term, int per_dir)
+{
+    struct name_table *t = cache_lookup(root);
+    if (t == NULL) {
+        if (!is_valid_root(root)) {
+            writer_line(w, "ERR root folder not found or is not a directory");
+            return;
+        }
+        size_t total = per_dir ? search_count_per_dir(root, term, write_dir_count, w)
+                               : search_count_all(root, term);
+        writer_status(w, total, NULL);
+        return;
+    }
+
+    size_t first;
+    size_t last;
+    match_range(t, term, &first, &last);
+    if (!per_dir || send_dir_counts(w, t, first, last)) {
+        writer_status(w, last - first, t);
+    }
+    table_release(t);
+}
+
+/* EXISTS. An uncached root is walked only until the first match. */
+static void handle_exists(struct pipe_writer *w, const char *root, const char *term)
+{
+    struct name_table *t = cache_lookup(root);
+    if (t == NULL) {
+        if (!is_valid_root(root)) {
+            writer_line(w, "ERR root folder not found or is not a directory");
+            return;
+        }
+        writer_status(w, search_exists(root, term) ? 1 : 0, NULL);
+        return;
+    }
+
+    size_t first = lower_bound(t, term, 0);
+    int found = (first < t->by_name_count &&
+                 name_vs_prefix(t->text + t->entries[t->by_name[first]].name_at,
+                                term) == 0);
+    writer_status(w, found ? 1 : 0, t);
+    table_release(t);
+}
+
+static void handle_find(struct pipe_writer *w, const char *root,
+                        const char *term, const char *order)
+{
+    int sorted    = 0;
+    int by_name   = 0;
+    int fold_case = 0;
+
+    if (order != NULL && !parse_order(order, &sorted, &by_name, &fold_case)) {
+        writer_line(w, "ERR unknown order");
+        return;
+    }
+
+    /* A sorted reply needs the whole walk first; an unsorted one can
+     * start while a cold root is still being walked */
+    struct find_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.w    = w;
+    stream.term = term;
+
+    struct name_table *t = cache_lookup(root);
+    if (t == NULL) {
+        if (!is_valid_root(root)) {
+            writer_line(w, "ERR root folder not found or is not a directory");
+            return;
+        }
+        t = cache_acquire(root, sorted ? NULL : &stream);
+        if (t == NULL) {
+            writer_line(w, "ERR out of memory");
+            return;
+        }
+    }
+
+    size_t first;
+    size_t last;
+    size_t matches = 0;
+    match_range(t, term, &first, &last);
+    if (stream.walked) {
+        matches = stream.sent;
+    } else if (sorted) {
+        if (!send_sorted(w, t, first, last, by_name, fold_case, &matches)) {
+            table_release(t);
+            return;
+        }
+    } else {
+        size_t i;
+        for (i = first; i < last && !w->failed; ++i) {
+            writer_line(w, t->text + t->entries[t->by_name[i]].path_at);
+        }
+        matches = last - first;
+    }
+    writer_status(w, matches, t);
+    table_release(t);
+}
+
+/* Splits line in place on tabs. Returns the number of fields found. */
+static int split_fields(char *line, char **fields, int max_fields)
+{
+    int n = 0;
+    fields[n++] = line;
+    while (*line && n < max_fields) {
+        if (*line == '\t') {
+            *line = '\0';
+            fields[n++] = line + 1;
+        }
+        ++line;
+    }
+    return n;
+}
+
+static void handle_request(struct pipe_writer *w, char *line)
+{
+    char *fields[4];
+    int n = split_fields(line, fields, 4);
+
+    if ((n == 3 || n == 4) && str_equals_icase(fields[0], "FIND")) {
+        handle_find(w, fields[1], fields[2], (n == 4) ? fields[3] : NULL);
+    } else if (n == 3 && str_equals_icase(fields[0], "COUNT")) {
+        handle_count(w, fields[1], fields[2], 0);
+    } else if (n == 3 && str_equals_icase(fields[0], "EXISTS")) {
+        handle_exists(w, fields[1], fields[2]);
+    } else if (n == 3 && str_equals_icase(fields[0], "DIRCOUNT")) {
+        handle_count(w, fields[1], fields[2], 1);
+    } else if (n == 2 && str_equals_icase(fields[0], "DROP")) {
+        cache_drop(fields[1]);
+        writer_line(w, "OK 0");
+    } else {
+        writer_line(w, "ERR unknown request");
+    }
+    writer_flush(w);
+}
+
+static DWORD WINAPI client_thread(LPVOID param)
+{
+    HANDLE pipe = (HANDLE)param;
+    struct pipe_writer *w = (struct pipe_writer *)malloc(sizeof(*w));
+    char line[SERVER_LINE_CAP];
+    size_t line_len = 0;
+
+    if (w == NULL) {
+        DisconnectNamedPipe(pipe);
+        CloseHandle(pipe);
+        return 1;
+    }
+    w->pipe   = pipe;
+    w->failed = 0;
+    w->len    = 0;
+
+    while (!w->failed) {
+        char  chunk[4096];
+        DWORD got = 0;
+        if (!ReadFile(pipe, chunk, sizeof(chunk), &got, NULL) || got == 0) {
+            break; /* client closed its end */
+        }
+
+        DWORD i;
+        for (i = 0; i < got && !w->failed; ++i) {
+            char c = chunk[i];
+            if (c == '\r') {
+                continue;
+            }
+            if (c != '\n') {
+                if (line_len + 1 >= sizeof(line)) {
+                    writer_line(w, "ERR request too long");
+                    writer_flush(w);
+                    w->failed = 1;
+                    break;
+                }
+                line[line_len++] = c;
+                continue;
+            }
+            line[line_len] = '\0';
+            line_len = 0;
+            handle_request(w, line);
+        }
+    }
+
+    FlushFileBuffers(pipe);
+    DisconnectNamedPipe(pipe);
+    CloseHandle(pipe);
+    free(w);
+    return 0;
+}
+
+/* -------------------------------------------------------------------------
+ * Public functions - called from main.c
+ * ---------------------------------------------------------------------- */
+
+/* Accepts clients forever, one thread per connection.
+ * The first instance is created with FILE_FLAG_FIRST_PIPE_INSTANCE, so a
+ * second server (or anything else holding the name) is refused instead of
+ * quietly sharing the pipe and splitting the clients between two caches.
+ * Returns 2 if the pipe name is already taken, 1 if a later instance
+ * cannot be created. */
+int server_run(void)
+{
+    DWORD first = FILE_FLAG_FIRST_PIPE_INSTANCE;
+
+    for (;;) {
+        HANDLE pipe = CreateNamedPipeA(SERVER_PIPE_NAME,
+                          PIPE_ACCESS_DUPLEX | first,
+                          PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT |
+                          PIPE_REJECT_REMOTE_CLIENTS,
+                          PIPE_UNLIMITED_INSTANCES,
+                          SERVER_PIPE_BUF, SERVER_PIPE_BUF, 0, NULL);
+        if (pipe == INVALID_HANDLE_VALUE) {
+            return first ? 2 : 1;
+        }
+        first = 0;
+
+        BOOL connected = ConnectNamedPipe(pipe, NULL) ||
+                         GetLastError() == ERROR_PIPE_CONNECTED;
+        if (!connected) {
+            CloseHandle(pipe);
+            continue;
+        }
+
+        HANDLE thread = CreateThread(NULL, 0, client_thread, pipe, 0, NULL);
+        if (thread == NULL) {
+            DisconnectNamedPipe(pipe);
+            CloseHandle(pipe);
+            continue;
+        }
+        CloseHandle(thread);
+    }
+}
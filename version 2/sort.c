@@ -0,0 +1,411 @@
+/*
+ * sort.c
+ * Sorting and de-duplication of result paths.
+ * Uses an MSD radix sort over the path bytes: comparison sorts spend most
+ * of their time re-reading the long shared prefixes ("C:\Users\...") of
+ * neighbouring paths, a radix sort reads every byte about once.
+ * Duplicates are dropped in the same pass, and large inputs are split
+ * across threads at the first byte where the paths differ.
+ */
+
+#include <windows.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define SORT_INSERTION_MAX  32       /* below this, insertion sort wins */
+#define SORT_PARALLEL_MIN   65536    /* below this, threads cost more   */
+#define SORT_MAX_THREADS    8
+#define SORT_BUCKETS        257      /* 0 = end of string, then bytes   */
+#define SORT_MAX_TASKS      512      /* ranges handed to the workers    */
+#define SORT_TASKS_PER_THREAD 8      /* split until ranges are this fine */
+#define SORT_FAILED         ((size_t)-1)
+
+struct sort_item {
+    const char *key;    /* what is sorted on: the path or its file name */
+    const char *path;   /* NULL once found to be a duplicate            */
+};
+
+struct sort_opts {
+    int by_name;        /* key is the file name, ties broken by path    */
+    int fold_case;
+};
+
+/* A range of items that one worker sorts from depth on */
+struct sort_task {
+    size_t start;
+    size_t count;
+    size_t depth;
+    int    settle;      /* keys are all equal: only settle_equal_keys   */
+};
+
+/* Shared by the worker threads of one parallel sort */
+struct sort_shared {
+    struct sort_item       *items;
+    struct sort_item       *tmp;
+    const struct sort_opts *opts;
+    struct sort_task        tasks[SORT_MAX_TASKS];
+    size_t                  task_count;
+    volatile LONG           next_task;
+};
+
+/* -------------------------------------------------------------------------
+ * Internal helpers (static)
+ * ---------------------------------------------------------------------- */
+
+/* Bucket of s at depth d: 0 at the end of the string, byte + 1 otherwise.
+ * Only called while every earlier byte was non-zero. */
+static int char_at(const char *s, size_t d, int fold_case)
+{
+    unsigned char c = (unsigned char)s[d];
+    if (c == '\0') {
+        return 0;
+    }
+    return (fold_case ? tolower(c) : c) + 1;
+}
+
+static int compare_from(const char *a, const char *b, size_t d, int fold_case)
+{
+    for (;; ++d) {
+        int ca = char_at(a, d, fold_case);
+        int cb = char_at(b, d, fold_case);
+        if (ca != cb || ca == 0) {
+            return ca - cb;
+        }
+    }
+}
+
+/* Full ordering of two items whose keys agree on the first d bytes */
+static int compare_items(const struct sort_item *a, const struct sort_item *b,
+                         size_t d, const struct sort_opts *opts)
+{
+    int r = compare_from(a->key, b->key, d, opts->fold_case);
+    if (r == 0 && opts->by_name) {
+        r = compare_from(a->path, b->path, 0, opts->fold_case);
+    }
+    return r;
+}
+
+static void insertion_sort(struct sort_item *items, size_t n, size_t d,
+                           const struct sort_opts *opts)
+{
+    size_t i;
+    for (i = 1; i < n; ++i) {
+        struct sort_item cur = items[i];
+        size_t j = i;
+        while (j > 0 && compare_items(&cur, &items[j - 1], d, opts) < 0) {
+            items[j] = items[j - 1];
+            --j;
+        }
+        items[j] = cur;
+    }
+    /* Equal items are now adjacent; keep only the first of each run */
+    size_t keep = 0;
+    for (i = 1; i < n; ++i) {
+        if (compare_items(&items[i], &items[keep], d, opts) == 0) {
+            items[i].path = NULL;
+        } else {
+            keep = i;
+        }
+    }
+}
+
+static void radix_sort(struct sort_item *items, struct sort_item *tmp,
+                       size_t n, size_t d, const struct sort_opts *opts);
+
+/* Items whose keys are completely equal. For file-name order they are
+ * sorted again by path; otherwise they are the same path, and all but
+ * the first are duplicates. */
+static void settle_equal_keys(struct sort_item *items, struct sort_item *tmp,
+                              size_t n, const struct sort_opts *opts)
+{
+    if (n < 2) {
+        return;
+    }
+    if (opts->by_name) {
+        struct sort_opts by_path = *opts;
+        size_t i;
+        by_path.by_name = 0;
+        for (i = 0; i < n; ++i) {
+            items[i].key = items[i].path;
+        }
+        radix_sort(items, tmp, n, 0, &by_path);
+        return;
+    }
+    size_t i;
+    for (i = 1; i < n; ++i) {
+        items[i].path = NULL;
+    }
+}
+
+/* Depth at which the keys first differ, starting from d. One pass that
+ * reads each key front to back is far cheaper than one counting pass
+ * per shared byte, since every pass touches every key again. */
+static size_t skip_common_prefix(const struct sort_item *items, size_t n,
+                                 size_t d, int fold_case)
+{
+    const char *first = items[0].key;
+    size_t end = d;
+    size_t i;
+
+    while (char_at(first, end, fold_case) != 0) {
+        ++end;
+    }
+    for (i = 1; i < n && end > d; ++i) {
+        size_t k = d;
+        while (k < end &&
+               char_at(items[i].key, k, fold_case) == char_at(first, k, fold_case)) {
+            ++k;
+        }
+        end = k;
+    }
+    return end;
+}
+
+/* Counts the buckets at depth d and moves every item into its bucket.
+ * Returns the index of the only non-empty bucket, or -1 if there are
+ * several (all items already in a single bucket are left in place). */
+static int distribute(struct sort_item *items, struct sort_item *tmp, size_t n,
+                      size_t d, int fold_case,
+                      size_t counts[SORT_BUCKETS], size_t starts[SORT_BUCKETS])
+{
+    size_t i;
+    int    c;
+
+    memset(counts, 0, SORT_BUCKETS * sizeof(counts[0]));
+    for (i = 0; i < n; ++i) {
+        counts[char_at(items[i].key, d, fold_case)]++;
+    }
+    for (c = 0; c < SORT_BUCKETS; ++c) {
+        if (counts[c] == n) {
+            return c;
+        }
+    }
+
+    size_t next[SORT_BUCKETS];
+    size_t pos = 0;
+    for (c = 0; c < SORT_BUCKETS; ++c) {
+        starts[c] = pos;
+        next[c]   = pos;
+        pos      += counts[c];
+    }
+    for (i = 0; i < n; ++i) {
+        tmp[next[char_at(items[i].key, d, fold_case)]++] = items[i];
+    }
+    memcpy(items, tmp, n * sizeof(*items));
+    return -1;
+}
+
+static void radix_sort(struct sort_item *items, struct sort_item *tmp,
+                       size_t n, size_t d, const struct sort_opts *opts)
+{
+    size_t counts[SORT_BUCKETS];
+    size_t starts[SORT_BUCKETS];
+
+    for (;;) {
+        if (n < SORT_INSERTION_MAX) {
+            insertion_sort(items, n, d, opts);
+            return;
+        }
+        d = skip_common_prefix(items, n, d, opts->fold_case);
+        int only = distribute(items, tmp, n, d, opts->fold_case, counts, starts);
+        if (only == 0) {
+            settle_equal_keys(items, tmp, n, opts);
+            return;
+        }
+        if (only < 0) {
+            break;
+        }
+        ++d; /* one shared byte left: step past it */
+    }
+
+    settle_equal_keys(items, tmp, counts[0], opts);
+    int c;
+    for (c = 1; c < SORT_BUCKETS; ++c) {
+        if (counts[c] > 1) {
+            radix_sort(items + starts[c], tmp + starts[c], counts[c], d + 1, opts);
+        }
+    }
+}
+
+static DWORD WINAPI sort_worker(LPVOID param)
+{
+    struct sort_shared *sh = (struct sort_shared *)param;
+    for (;;) {
+        LONG i = InterlockedIncrement(&sh->next_task) - 1;
+        if ((size_t)i >= sh->task_count) {
+            return 0;
+        }
+        const struct sort_task *t = &sh->tasks[i];
+        if (t->settle) {
+            settle_equal_keys(sh->items + t->start, sh->tmp + t->start,
+                              t->count, sh->opts);
+        } else {
+            radix_sort(sh->items + t->start, sh->tmp + t->start,
+                       t->count, t->depth, sh->opts);
+        }
+    }
+}
+
+static void add_task(struct sort_shared *sh, size_t start, size_t count,
+                     size_t depth, int settle)
+{
+    struct sort_task *t = &sh->tasks[sh->task_count++];
+    t->start  = start;
+    t->count  = count;
+    t->depth  = depth;
+    t->settle = settle;
+}
+
+/* Cuts the input into ranges for the workers. The largest range is split
+ * at the first depth where its keys differ, again and again, until every
+ * range is small enough to share out evenly. Paths under one root all
+ * start with the same bytes, and one folder often holds most of them, so
+ * a single split - let alone one on the first byte - leaves nearly all
+ * the work in one range. */
+static void split_tasks(struct sort_shared *sh, size_t n, DWORD threads)
+{
+    size_t target = n / (threads * SORT_TASKS_PER_THREAD);
+    size_t counts[SORT_BUCKETS];
+    size_t starts[SORT_BUCKETS];
+
+    sh->task_count = 0;
+    add_task(sh, 0, n, 0, 0);
+
+    while (sh->task_count + SORT_BUCKETS <= SORT_MAX_TASKS) {
+        size_t big = sh->task_count;
+        size_t i;
+        for (i = 0; i < sh->task_count; ++i) {
+            if (!sh->tasks[i].settle && sh->tasks[i].count > target &&
+                (big == sh->task_count || sh->tasks[i].count > sh->tasks[big].count)) {
+                big = i;
+            }
+        }
+        if (big == sh->task_count) {
+            break;
+        }
+
+        struct sort_task t = sh->tasks[big];
+        sh->tasks[big] = sh->tasks[--sh->task_count];
+
+        struct sort_item *items = sh->items + t.start;
+        size_t d = skip_common_prefix(items, t.count, t.depth, sh->opts->fold_case);
+        if (distribute(items, sh->tmp + t.start, t.count, d, sh->opts->fold_case,
+                       counts, starts) >= 0) {
+            add_task(sh, t.start, t.count, d, 1); /* every key is the same */
+            continue;
+        }
+        int c;
+        for (c = 0; c < SORT_BUCKETS; ++c) {
+            if (counts[c] > 1) {
+                add_task(sh, t.start + starts[c], counts[c], d + 1, c == 0);
+            }
+        }
+    }
+}
+
+/* The ranges from split_tasks are handed out to workers one at a time.
+ * They never overlap, so the workers share nothing but the counter. */
+static void radix_sort_parallel(struct sort_item *items, struct sort_item *tmp,
+                                size_t n, const struct sort_opts *opts)
+{
+    struct sort_shared *sh;
+    SYSTEM_INFO si;
+    HANDLE threads[SORT_MAX_THREADS];
+    DWORD  started = 0;
+    DWORD  want;
+    DWORD  i;
+
+    GetSystemInfo(&si);
+    want = si.dwNumberOfProcessors;
+    if (want > SORT_MAX_THREADS) {
+        want = SORT_MAX_THREADS;
+    }
+    sh = (n >= SORT_PARALLEL_MIN && want >= 2)
+       ? (struct sort_shared *)malloc(sizeof(*sh)) : NULL;
+    if (sh == NULL) {
+        radix_sort(items, tmp, n, 0, opts);
+        return;
+    }
+
+    sh->items     = items;
+    sh->tmp       = tmp;
+    sh->opts      = opts;
+    sh->next_task = 0;
+    split_tasks(sh, n, want);
+
+    for (i = 0; i < want && sh->task_count > 1; ++i) {
+        threads[started] = CreateThread(NULL, 0, sort_worker, sh, 0, NULL);
+        if (threads[started] != NULL) {
+            ++started;
+        }
+    }
+    sort_worker(sh); /* this thread helps too, and copes if none started */
+
+    if (started > 0) {
+        WaitForMultipleObjects(started, threads, TRUE, INFINITE);
+    }
+    for (i = 0; i < started; ++i) {
+        CloseHandle(threads[i]);
+    }
+    free(sh);
+}
+
+static const char *file_name_of(const char *path)
+{
+    const char *name = path;
+    const char *p;
+    for (p = path; *p; ++p) {
+        if (*p == '\\' || *p == '/') {
+            name = p + 1;
+        }
+    }
+    return name;
+}
+
+/* -------------------------------------------------------------------------
+ * Public functions
+ * ---------------------------------------------------------------------- */
+
+/* Sorts paths in place by full path (by_name = 0) or by file name, then
+ * full path (by_name = 1), optionally ignoring case, and removes paths
+ * that compare equal. Returns how many paths are left, or SORT_FAILED
+ * ((size_t)-1) if memory runs out; the paths are then left untouched. */
+size_t paths_sort_unique(const char **paths, size_t count,
+                         int by_name, int fold_case)
+{
+    struct sort_opts  opts;
+    struct sort_item *items;
+    struct sort_item *tmp;
+    size_t i;
+    size_t kept = 0;
+
+    if (count < 2) {
+        return count;
+    }
+    items = (struct sort_item *)malloc(count * sizeof(*items));
+    tmp   = (struct sort_item *)malloc(count * sizeof(*tmp));
+    if (items == NULL || tmp == NULL) {
+        free(items);
+        free(tmp);
+        return SORT_FAILED;
+    }
+
+    opts.by_name   = by_name;
+    opts.fold_case = fold_case;
+    for (i = 0; i < count; ++i) {
+        items[i].path = paths[i];
+        items[i].key  = by_name ? file_name_of(paths[i]) : paths[i];
+    }
+
+    radix_sort_parallel(items, tmp, count, &opts);
+
+    for (i = 0; i < count; ++i) {
+        if (items[i].path != NULL) {
+            paths[kept++] = items[i].path;
+        }
+    }
+    free(items);
+    free(tmp);
+    return kept;
+}
@@ -0,0 +1,215 @@
+/*
+ * throttle.c
+ * Background crawl mode for the directory walk.
+ * - Drops the walking thread to background CPU and I/O priority.
+ * - Caps directories opened and entries listed per second with token buckets.
+ * - Slows down further when directory opens start taking longer than usual,
+ *   which is the first sign that the disk is busy with real work.
+ * The bucket is shared by every thread, so the limit holds for the whole
+ * process no matter how many walks run at once.
+ */
+
+#include <windows.h>
+
+/* Backoff tuning */
+#define THROTTLE_LATENCY_ALPHA   0.2   /* weight of the newest sample in the average */
+#define THROTTLE_LATENCY_FLOOR   1.0   /* ms; below this nothing counts as slow     */
+#define THROTTLE_BACKOFF_FACTOR  3.0   /* slow = this many times the usual latency  */
+#define THROTTLE_ADJUST_MS       250.0 /* at most one rate change per interval      */
+#define THROTTLE_MIN_SCALE       (1.0 / 64.0)
+#define THROTTLE_RECOVER_STEP    0.05
+
+static SRWLOCK g_lock         = SRWLOCK_INIT;
+static int     g_enabled      = 0;
+static double  g_dir_rate     = 0.0;  /* per second, 0 = no limit */
+static double  g_entry_rate   = 0.0;  /* per second, 0 = no limit */
+static double  g_dir_tokens   = 0.0;
+static double  g_entry_tokens = 0.0;
+static double  g_scale        = 1.0;  /* backoff multiplier on both rates */
+static double  g_latency_avg  = 0.0;  /* ms, moving average            */
+static double  g_latency_base = 0.0;  /* ms, what "usual" looks like   */
+static double  g_last_refill  = 0.0;  /* ms timestamps */
+static double  g_last_adjust  = 0.0;
+
+/* -------------------------------------------------------------------------
+ * Internal helpers (static)
+ * ---------------------------------------------------------------------- */
+
+static double now_ms(void)
+{
+    static LONGLONG freq = 0;
+    LARGE_INTEGER t;
+    if (freq == 0) {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        freq = f.QuadPart;
+    }
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart * 1000.0 / (double)freq;
+}
+
+/* Adds the tokens earned since the last call. The bucket holds at most
+ * one second's worth so an idle period cannot turn into a burst.
+ * Caller holds g_lock. */
+static void refill(double now)
+{
+    double elapsed_s = (now - g_last_refill) / 1000.0;
+    g_last_refill = now;
+
+    if (g_dir_rate > 0.0) {
+        double rate  = g_dir_rate * g_scale;
+        double burst = (rate > 1.0) ? rate : 1.0;
+        g_dir_tokens += elapsed_s * rate;
+        if (g_dir_tokens > burst) {
+            g_dir_tokens = burst;
+        }
+    }
+    if (g_entry_rate > 0.0) {
+        double rate = g_entry_rate * g_scale;
+        g_entry_tokens += elapsed_s * rate;
+        if (g_entry_tokens > rate) {
+            g_entry_tokens = rate;
+        }
+    }
+}
+
+/* Milliseconds until both buckets can pay for one directory, 0 if they
+ * already can. Entries are charged after the listing is read, so the entry
+ * bucket only has to be out of debt. Caller holds g_lock. */
+static double wait_needed(void)
+{
+    double wait = 0.0;
+    if (g_dir_rate > 0.0 && g_dir_tokens < 1.0) {
+        wait = (1.0 - g_dir_tokens) * 1000.0 / (g_dir_rate * g_scale);
+    }
+    if (g_entry_rate > 0.0 && g_entry_tokens < 0.0) {
+        double entry_wait = -g_entry_tokens * 1000.0 / (g_entry_rate * g_scale);
+        if (entry_wait > wait) {
+            wait = entry_wait;
+        }
+    }
+    return wait;
+}
+
+/* Multiplicative decrease when opens get slow, additive increase when
+ * they recover. Caller holds g_lock. */
+static void adjust_scale(double now)
+{
+    if (now - g_last_adjust < THROTTLE_ADJUST_MS) {
+        return;
+    }
+    g_last_adjust = now;
+
+    int slow = (g_latency_avg > THROTTLE_LATENCY_FLOOR &&
+                g_latency_avg > g_latency_base * THROTTLE_BACKOFF_FACTOR);
+    if (slow) {
+        g_scale *= 0.5;
+        if (g_scale < THROTTLE_MIN_SCALE) {
+            g_scale = THROTTLE_MIN_SCALE;
+        }
+    } else if (g_scale < 1.0) {
+        g_scale += THROTTLE_RECOVER_STEP;
+        if (g_scale > 1.0) {
+            g_scale = 1.0;
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------
+ * Public functions
+ * ---------------------------------------------------------------------- */
+
+/* Turns background crawling on for search_directory_each. A rate of 0
+ * leaves that dimension unlimited; the priority drop always applies. */
+void throttle_configure(double dirs_per_sec, double entries_per_sec)
+{
+    AcquireSRWLockExclusive(&g_lock);
+    g_enabled      = 1;
+    g_dir_rate     = (dirs_per_sec  > 0.0) ? dirs_per_sec  : 0.0;
+    g_entry_rate   = (entries_per_sec > 0.0) ? entries_per_sec : 0.0;
+    g_dir_tokens   = 1.0;
+    g_entry_tokens = 0.0;
+    g_scale        = 1.0;
+    g_latency_avg  = 0.0;
+    g_latency_base = 0.0;
+    g_last_refill  = now_ms();
+    g_last_adjust  = g_last_refill;
+    ReleaseSRWLockExclusive(&g_lock);
+}
+
+int throttle_active(void)
+{
+    AcquireSRWLockShared(&g_lock);
+    int enabled = g_enabled;
+    ReleaseSRWLockShared(&g_lock);
+    return enabled;
+}
+
+/* Background mode lowers CPU, I/O and memory priority for this thread
+ * only, so it must be entered and left on the thread doing the walk. */
+void throttle_enter_background(void)
+{
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+}
+
+void throttle_leave_background(void)
+{
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+}
+
+/* Blocks until the walk may open one more directory, then takes its token. */
+void throttle_wait_dir(void)
+{
+    for (;;) {
+        AcquireSRWLockExclusive(&g_lock);
+        refill(now_ms());
+        double wait = wait_needed();
+        if (wait <= 0.0) {
+            if (g_dir_rate > 0.0) {
+                g_dir_tokens -= 1.0;
+            }
+            ReleaseSRWLockExclusive(&g_lock);
+            return;
+        }
+        ReleaseSRWLockExclusive(&g_lock);
+        Sleep((DWORD)wait + 1);
+    }
+}
+
+/* Records how long opening a directory took and adjusts the backoff. */
+void throttle_charge_open(double open_ms)
+{
+    AcquireSRWLockExclusive(&g_lock);
+    if (g_latency_avg == 0.0) {
+        g_latency_avg  = open_ms;
+        g_latency_base = open_ms;
+    } else {
+        g_latency_avg += THROTTLE_LATENCY_ALPHA * (open_ms - g_latency_avg);
+        /* Follow drops at once but rises only slowly, so a sustained
+         * slowdown is still seen as one instead of becoming the norm. */
+        if (g_latency_avg < g_latency_base) {
+            g_latency_base = g_latency_avg;
+        } else {
+            g_latency_base += 0.01 * (g_latency_avg - g_latency_base);
+        }
+    }
+    adjust_scale(now_ms());
+    ReleaseSRWLockExclusive(&g_lock);
+}
+
+/* Charges listed entries. They may push the bucket into debt, which the
+ * next throttle_wait_dir sleeps off. */
+void throttle_charge_entries(double entries)
+{
+    AcquireSRWLockExclusive(&g_lock);
+    if (g_entry_rate > 0.0) {
+        g_entry_tokens -= entries;
+    }
+    ReleaseSRWLockExclusive(&g_lock);
+}
+
+/* Timer shared with search.c so open latency uses the same clock. */
+double throttle_now_ms(void)
+{
+    return now_ms();
+}